@@ -14,6 +14,7 @@
 
 #include <graphene/egenesis/egenesis.hpp>
 
+#include <graphene/net/config.hpp>
 #include <graphene/net/core_messages.hpp>
 #include <graphene/net/exceptions.hpp>
 
@@ -25,6 +26,7 @@
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/crypto/base64.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/signals2.hpp>
@@ -535,6 +537,31 @@ void application_impl::open_chain_database() const
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   if( _options->count("object-database-checkpoint-interval") > 0 )
+   {
+      _chain_db->enable_object_database_checkpoints(
+            _options->at("object-database-checkpoint-interval").as<uint32_t>(),
+            _options->count("object-database-checkpoint-segments") > 0 ?
+                  _options->at("object-database-checkpoint-segments").as<uint32_t>() : 100 );
+   }
+
+   if( _options->count("block-log-segment-size") > 0 || _options->count("compress-block-log") > 0 )
+   {
+      _chain_db->set_block_log_layout(
+            _options->count("block-log-segment-size") > 0 ? _options->at("block-log-segment-size").as<uint32_t>() : 0,
+            _options->count("compress-block-log") > 0 && _options->at("compress-block-log").as<bool>() );
+   }
+
+   if( _options->count("replay-lookahead") > 0 )
+      _chain_db->set_replay_lookahead( _options->at("replay-lookahead").as<uint32_t>() );
+
+   if( _options->count("max-pending-transactions-per-account") > 0 )
+      _chain_db->set_max_pending_transactions_per_account(
+            _options->at("max-pending-transactions-per-account").as<uint32_t>() );
+
+   if( _options->count("vote-tally-recount-interval") > 0 )
+      _chain_db->set_vote_tally_recount_interval( _options->at("vote-tally-recount-interval").as<uint32_t>() );
+
    if( _options->count("replay-blockchain") > 0 || _options->count("revalidate-blockchain") > 0 )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
@@ -630,6 +657,18 @@ bool application_impl::has_item(const net::item_id& id)
    FC_CAPTURE_AND_RETHROW( (id) ) // GCOVR_EXCL_LINE
 }
 
+uint32_t application_impl::block_precompute_skip_flags()const
+{
+   return (_is_block_producer || _force_validate) ? database::skip_nothing : database::skip_transaction_signatures;
+}
+
+fc::future<void> application_impl::precompute_block(const graphene::net::block_message& blk_msg)const
+{
+   // Uses the thread pool of precompute_parallel(), like the replay.  The results are cached in the block and
+   // copied along with it into handle_block(), which finds the work done already.
+   return _chain_db->precompute_parallel( blk_msg.block, block_precompute_skip_flags() );
+}
+
 /*
  * @brief allows the application to validate an item prior to broadcasting to peers.
  *
@@ -663,8 +702,7 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
                     "Rejecting block with timestamp in the future", );
 
    try {
-      const uint32_t skip = (_is_block_producer || _force_validate) ?
-                               database::skip_nothing : database::skip_transaction_signatures;
+      const uint32_t skip = block_precompute_skip_flags();
       bool result = valve.do_serial( [this,&blk_msg,skip] () {
          _chain_db->precompute_parallel( blk_msg.block, skip ).wait();
       }, [this,&blk_msg,skip] () {
@@ -711,22 +749,56 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
    }
 } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) return false; } // GCOVR_EXCL_LINE
 
-void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message)
-{ try {
+void application_impl::count_transactions_from_network( size_t count )const
+{
    static fc::time_point last_call;
-   static int trx_count = 0;
-   ++trx_count;
+   static size_t trx_count = 0;
+   trx_count += count;
    auto now = fc::time_point::now();
    if( now - last_call > fc::seconds(1) ) {
       ilog("Got ${c} transactions from network", ("c",trx_count) );
       last_call = now;
       trx_count = 0;
    }
+}
+
+void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message)
+{ try {
+   count_transactions_from_network( 1 );
 
    _chain_db->precompute_parallel( transaction_message.trx ).wait();
    _chain_db->push_transaction( transaction_message.trx );
 } FC_CAPTURE_AND_RETHROW( (transaction_message) ) } // GCOVR_EXCL_LINE
 
+std::vector<fc::oexception> application_impl::handle_transactions(
+      const std::vector<graphene::net::trx_message>& transaction_messages)
+{ try {
+   count_transactions_from_network( transaction_messages.size() );
+
+   std::vector<graphene::protocol::precomputable_transaction> trxs;
+   trxs.reserve( transaction_messages.size() );
+   for( const auto& transaction_message : transaction_messages )
+      trxs.push_back( transaction_message.trx );
+
+   _chain_db->precompute_parallel( trxs ).wait();
+
+   // a whole batch at once could hold up block production on this thread
+   std::vector<fc::oexception> results;
+   results.reserve( trxs.size() );
+   for( size_t first = 0; first < trxs.size(); first += GRAPHENE_NET_TRX_PER_APPLY_SLICE )
+   {
+      if( first > 0 )
+         fc::yield();
+      const size_t last = std::min<size_t>( first + GRAPHENE_NET_TRX_PER_APPLY_SLICE, trxs.size() );
+      std::vector<graphene::protocol::precomputable_transaction> slice(
+            std::make_move_iterator( trxs.begin() + first ), std::make_move_iterator( trxs.begin() + last ) );
+      auto slice_results = _chain_db->push_transactions( slice );
+      results.insert( results.end(), std::make_move_iterator( slice_results.begin() ),
+                      std::make_move_iterator( slice_results.end() ) );
+   }
+   return results;
+} FC_CAPTURE_AND_RETHROW( (transaction_messages.size()) ) } // GCOVR_EXCL_LINE
+
 void application_impl::handle_message(const message& message_to_process)
 {
    // not a transaction, not a block
@@ -1207,6 +1279,23 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("object-database-checkpoint-interval", bpo::value<uint32_t>(),
+          "Save the objects changed since the last save to disk every this many irreversible blocks, so that the "
+          "node can resume without a replay after an unclean shutdown. 0 disables checkpoints (default: 0)")
+         ("object-database-checkpoint-segments", bpo::value<uint32_t>()->default_value(100),
+          "Number of incremental checkpoints before the whole object database is written to disk again")
+         ("block-log-segment-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of blocks per file of a newly created block log, 0 for a single file. "
+          "An existing block log keeps its layout")
+         ("compress-block-log", bpo::value<bool>()->default_value(false),
+          "Whether to compress the blocks of a newly created block log. An existing block log keeps its layout")
+         ("replay-lookahead", bpo::value<uint32_t>()->default_value(200),
+          "Maximum number of blocks read and verified ahead of the block being applied during a replay")
+         ("max-pending-transactions-per-account", bpo::value<uint32_t>()->default_value(1000),
+          "Maximum number of pending transactions per fee paying account, 0 for no limit")
+         ("vote-tally-recount-interval", bpo::value<uint32_t>()->default_value(10),
+          "Recount the votes of all accounts every this many maintenance intervals and reuse what unchanged "
+          "accounts added to the previous tally in between, 0 or 1 to always recount")
          ("api-limit-get-account-history-operations",
           bpo::value<uint32_t>()->default_value(default_opts.api_limit_get_account_history_operations),
           "For history_api::get_account_history_operations to set max limit value")
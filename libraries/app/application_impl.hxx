@@ -65,12 +65,25 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
       bool handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
                         std::vector<graphene::net::message_hash_type>& contained_transaction_msg_ids) override;
 
+      /// Starts the signature, merkle root and transaction ID computations of a block received during sync
+      fc::future<void> precompute_block(const graphene::net::block_message& blk_msg)const override;
+
       void handle_transaction(const graphene::net::trx_message& transaction_message) override;
 
+      /// Recovers the signing keys of all the transactions in parallel, then pushes them in order
+      std::vector<fc::oexception> handle_transactions(
+            const std::vector<graphene::net::trx_message>& transaction_messages) override;
+
       void handle_message(const graphene::net::message& message_to_process) override;
 
       bool is_included_block(const graphene::chain::block_id_type& block_id);
 
+      /// Skip flags of the precomputation of incoming blocks
+      uint32_t block_precompute_skip_flags()const;
+
+      /// Logs the number of transactions received from the network about once per second
+      void count_transactions_from_network( size_t count )const;
+
       /**
        * Assuming all data elements are ordered in some way, this method should
        * return up to limit ids that occur *after* the last ID in synopsis that
@@ -2612,7 +2612,9 @@ bool database_api_impl::verify_authority( const signed_transaction& trx )const
                          [this]( account_id_type id, const operation& op, rejected_predicate_map* rejects ) {
                            return _db.get_viable_custom_authorities(id, op, rejects); },
                          allow_non_immediate_owner,
-                         _db.get_global_properties().parameters.max_authority_depth );
+                         MUST_IGNORE_CUSTOM_OP_REQD_AUTHS(_db.head_block_time()),
+                         _db.get_global_properties().parameters.max_authority_depth,
+                         _db.get_authority_cache() );
    return true;
 }
 
@@ -3100,29 +3102,27 @@ vector<limit_order_object> database_api_impl::get_limit_orders( const asset_id_t
               "limit can not be greater than ${configured_limit}",
               ("configured_limit", configured_limit) );
 
-   const auto& limit_order_idx = _db.get_index_type<limit_order_index>();
-   const auto& limit_price_idx = limit_order_idx.indices().get<by_price>();
+   const auto& order_book = _db.get_index_type< primary_index< limit_order_index > >()
+                               .get_secondary_index< limit_order_book_index >();
 
    vector<limit_order_object> result;
    result.reserve(limit*2);
 
-   uint32_t count = 0;
-   auto limit_itr = limit_price_idx.lower_bound(price::max(a,b));
-   auto limit_end = limit_price_idx.upper_bound(price::min(a,b));
-   while(limit_itr != limit_end && count < limit)
-   {
-      result.push_back(*limit_itr);
-      ++limit_itr;
-      ++count;
-   }
-   count = 0;
-   limit_itr = limit_price_idx.lower_bound(price::max(b,a));
-   limit_end = limit_price_idx.upper_bound(price::min(b,a));
-   while(limit_itr != limit_end && count < limit)
-   {
-      result.push_back(*limit_itr);
-      ++limit_itr;
-      ++count;
+   for( const auto& side_assets : { std::make_pair(a,b), std::make_pair(b,a) } )
+   {
+      const auto* side = order_book.find_side( side_assets.first, side_assets.second );
+      if( side == nullptr )
+         continue;
+      uint32_t count = 0;
+      for( auto level_itr = side->begin(); level_itr != side->end() && count < limit; ++level_itr )
+      {
+         for( auto order_itr = level_itr->second.orders.begin();
+              order_itr != level_itr->second.orders.end() && count < limit; ++order_itr )
+         {
+            result.push_back( *order_itr->second );
+            ++count;
+         }
+      }
    }
 
    return result;
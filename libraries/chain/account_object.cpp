@@ -235,6 +235,97 @@ void account_member_index::object_modified(const object& after)
 
 }
 
+void account_authority_cache::object_inserted( const object& obj )
+{
+   changed( static_cast<const account_object&>( obj ).get_id() );
+}
+
+void account_authority_cache::object_removed( const object& obj )
+{
+   changed( static_cast<const account_object&>( obj ).get_id() );
+}
+
+void account_authority_cache::about_to_modify( const object& before )
+{
+   const account_object& a = static_cast<const account_object&>( before );
+   _authorities_being_modified.emplace( a.owner, a.active );
+}
+
+void account_authority_cache::object_modified( const object& after )
+{
+   const account_object& a = static_cast<const account_object&>( after );
+   const auto& before = _authorities_being_modified.top();
+   if( !( before.first == a.owner ) || !( before.second == a.active ) )
+      changed( a.get_id() );
+   _authorities_being_modified.pop();
+}
+
+uint32_t account_authority_cache::version( const account_id_type& account )const
+{
+   return account.instance.value < _versions.size() ? _versions[account.instance.value] : 0;
+}
+
+void account_authority_cache::changed( const account_id_type& account )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( account.instance.value >= _versions.size() )
+      _versions.resize( account.instance.value + 1, 0 );
+   ++_versions[account.instance.value];
+}
+
+bool account_authority_cache::satisfied( const authority_check_key& key )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto& by_key_idx = _entries.get<by_key>();
+   auto itr = by_key_idx.find( key );
+   if( itr == by_key_idx.end() )
+      return false;
+   for( const auto& account : itr->accounts_read )
+   {
+      if( version( account.first ) != account.second )
+      {
+         by_key_idx.erase( itr );
+         return false;
+      }
+   }
+   _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+   return true;
+}
+
+void account_authority_cache::add( authority_check_key&& key, const flat_set<account_id_type>& accounts_read )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _capacity == 0 )
+      return;
+   entry e;
+   e.key = std::move( key );
+   e.accounts_read.reserve( accounts_read.size() );
+   for( const auto& account : accounts_read )
+      e.accounts_read.emplace_back( account, version( account ) );
+
+   auto& by_key_idx = _entries.get<by_key>();
+   auto itr = by_key_idx.find( e.key );
+   if( itr != by_key_idx.end() )
+      by_key_idx.erase( itr );
+   _entries.push_front( std::move( e ) );
+   while( _entries.size() > _capacity )
+      _entries.pop_back();
+}
+
+void account_authority_cache::set_capacity( size_t capacity )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _capacity = capacity;
+   while( _entries.size() > _capacity )
+      _entries.pop_back();
+}
+
+size_t account_authority_cache::size()const
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   return _entries.size();
+}
+
 const uint8_t  balances_by_account_index::bits = 20;
 const uint64_t balances_by_account_index::mask = (1ULL << balances_by_account_index::bits) - 1;
 
@@ -4,8 +4,14 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <boost/endian/buffers.hpp>
 
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -18,30 +24,208 @@ struct index_entry
    boost::endian::little_uint32_buf_t block_size;
    block_id_type                      block_id;
 };
+
+/// Layout of a block log, stored in its "format" file.  Logs without that file use the legacy layout.
+struct block_log_format
+{
+   uint32_t segment_size = 0;
+   bool     compress = false;
+};
  }}
 FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
+FC_REFLECT( graphene::chain::block_log_format, (segment_size)(compress) );
 
 namespace graphene { namespace chain {
 
+namespace {
+   /// Blocks stored in a compressed log are prefixed by one of these
+   enum compressed_record_type : char
+   {
+      raw_record  = 0,
+      zlib_record = 1 ///< followed by the uncompressed size and a zlib stream using the dictionary
+   };
+
+   /// The dictionary is built from the blocks before this one
+   constexpr uint32_t dictionary_training_blocks = 10000;
+   /// zlib uses at most 32 KiB of dictionary
+   constexpr size_t   max_dictionary_size = 32 * 1024;
+   constexpr size_t   dictionary_sample_size = 1024;
+
+   std::vector<char> zlib_compress( const std::vector<char>& in, const std::string& dictionary )
+   {
+      z_stream zs;
+      std::memset( &zs, 0, sizeof(zs) );
+      FC_ASSERT( deflateInit( &zs, Z_DEFAULT_COMPRESSION ) == Z_OK );
+      if( deflateSetDictionary( &zs, (const Bytef*)dictionary.data(), dictionary.size() ) != Z_OK )
+      {
+         deflateEnd( &zs );
+         FC_THROW( "Failed to set the compression dictionary" );
+      }
+      std::vector<char> out( deflateBound( &zs, in.size() ) );
+      zs.next_in = (Bytef*)in.data();
+      zs.avail_in = in.size();
+      zs.next_out = (Bytef*)out.data();
+      zs.avail_out = out.size();
+      const int result = deflate( &zs, Z_FINISH );
+      deflateEnd( &zs );
+      FC_ASSERT( result == Z_STREAM_END, "Failed to compress block" );
+      out.resize( zs.total_out );
+      return out;
+   }
+
+   std::vector<char> zlib_uncompress( const char* data, size_t size, size_t raw_size, const std::string& dictionary )
+   {
+      z_stream zs;
+      std::memset( &zs, 0, sizeof(zs) );
+      FC_ASSERT( inflateInit( &zs ) == Z_OK );
+      std::vector<char> out( raw_size );
+      zs.next_in = (Bytef*)data;
+      zs.avail_in = size;
+      zs.next_out = (Bytef*)out.data();
+      zs.avail_out = out.size();
+      int result = inflate( &zs, Z_FINISH );
+      if( result == Z_NEED_DICT )
+      {
+         if( inflateSetDictionary( &zs, (const Bytef*)dictionary.data(), dictionary.size() ) == Z_OK )
+            result = inflate( &zs, Z_FINISH );
+      }
+      inflateEnd( &zs );
+      FC_ASSERT( result == Z_STREAM_END && zs.total_out == raw_size, "Failed to uncompress block" );
+      return out;
+   }
+}
+
+namespace {
+   /// Mappings are made in multiples of this, so that a growing file is not mapped again for every new block
+   constexpr uint64_t mapping_step = 64 * 1024 * 1024;
+
+   uint64_t mapping_size( uint64_t file_size )
+   {
+#ifdef _WIN32
+      // a read-only mapping cannot extend a file on Windows
+      return file_size;
+#else
+      // readers only access data that has been flushed to the file, never the pages beyond its end
+      return ( file_size / mapping_step + 1 ) * mapping_step;
+#endif
+   }
+}
+
+struct block_database::mapped_file
+{
+   mapped_file( const fc::path& path, uint64_t s )
+   : file( path.generic_string().c_str(), fc::read_only ), region( file, fc::read_only, 0, s ), size( s ) {}
+
+   const char* data()const { return static_cast<const char*>( region.get_address() ); }
+
+   fc::file_mapping  file;
+   fc::mapped_region region;
+   const uint64_t    size;
+};
+
+block_database::block_database() = default;
+
+block_database::~block_database() = default;
+
+void block_database::set_layout_for_new_log( uint32_t segment_size, bool compress )
+{
+   _new_segment_size = segment_size;
+   _new_compress = compress;
+}
+
 void block_database::open( const fc::path& dbdir )
 { try {
    fc::create_directories(dbdir);
    _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
    _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
+   _dir = dbdir;
    _index_filename = dbdir / "index";
-   if( !fc::exists( _index_filename ) )
+   const fc::path format_filename = dbdir / "format";
+   const bool new_log = !fc::exists( _index_filename );
+   if( new_log )
+   {
+      fc::remove_all( format_filename );
+      fc::remove_all( dbdir / "dictionary" );
+   }
+   block_log_format format;
+   if( fc::exists( format_filename ) )
+   {
+      std::ifstream in( format_filename.generic_string().c_str(), std::ios::binary );
+      std::vector<char> data( (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>() );
+      format = fc::raw::unpack<block_log_format>( data );
+   }
+   else if( new_log && ( _new_segment_size > 0 || _new_compress ) )
    {
+      format.segment_size = _new_segment_size;
+      format.compress = _new_compress;
+      const auto data = fc::raw::pack( format );
+      std::ofstream out( format_filename.generic_string().c_str(), std::ios::binary | std::ios::trunc );
+      out.write( data.data(), data.size() );
+      out.close();
+      FC_ASSERT( out.good(), "Failed to write ${f}", ("f",format_filename) );
+   }
+   if( format.segment_size != _new_segment_size || format.compress != _new_compress )
+      wlog( "Keeping the layout of the existing block log, segment size ${s}, compressed ${c}",
+            ("s",format.segment_size)("c",format.compress) );
+   _segment_size = format.segment_size;
+   _compress = format.compress;
+
+   std::shared_ptr<const std::string> dictionary;
+   if( _compress && fc::exists( dbdir / "dictionary" ) )
+   {
+      std::ifstream in( (dbdir / "dictionary").generic_string().c_str(), std::ios::binary );
+      dictionary = std::make_shared<const std::string>( (std::istreambuf_iterator<char>(in)),
+                                                        std::istreambuf_iterator<char>() );
+   }
+   std::atomic_store( &_dictionary, dictionary );
+
+   if( new_log )
+   {
+     // a new log, drop blocks which are not referenced by an index
+     for( uint32_t segment = 0; fc::exists( segment_filename( segment ) ); ++segment )
+        fc::remove( segment_filename( segment ) );
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
    }
    else
-   {
      _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-   }
+   open_segment( 0 );
+
+   std::atomic_store( &_index_map, mapped_file_ptr() );
+   clear_segment_maps();
+   _segment_offsets.clear();
+   flush_files();
+   _index_size = fc::file_size( _index_filename );
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
+fc::path block_database::segment_filename( uint32_t segment )const
+{
+   if( _segment_size == 0 )
+      return _dir / "blocks";
+   return _dir / ( "blocks." + fc::to_string( segment ) );
+}
+
+uint32_t block_database::segment_of( uint32_t block_num )const
+{
+   return _segment_size == 0 ? 0 : block_num / _segment_size;
+}
+
+void block_database::open_segment( uint32_t segment )
+{
+   if( _blocks.is_open() )
+   {
+      if( _blocks_segment == segment )
+         return;
+      _blocks.close();
+   }
+   const fc::path file = segment_filename( segment );
+   if( !fc::exists( file ) )
+      _blocks.open( file.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+   else
+      _blocks.open( file.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   _blocks_segment = segment;
+}
+
 bool block_database::is_open()const
 {
   return _blocks.is_open();
@@ -49,14 +233,51 @@ bool block_database::is_open()const
 
 void block_database::close()
 {
+  _index_size = 0;
+  std::atomic_store( &_index_map, mapped_file_ptr() );
+  clear_segment_maps();
   _blocks.close();
   _block_num_to_pos.close();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+  flush_files();
+}
+
+void block_database::flush_files()
+{
+   // the block data must be readable before the index entry pointing to it
+   _blocks.flush();
+   _block_num_to_pos.flush();
+}
+
+void block_database::train_dictionary()
+{
+   // Samples of the blocks spread over the training range, the common parts of the serialization (headers,
+   // signatures layout, frequent operations) end up in the dictionary
+   std::string dictionary;
+   const uint32_t samples = max_dictionary_size / dictionary_sample_size;
+   for( uint32_t i = 0; i < samples; ++i )
+   {
+      optional<signed_block> b = fetch_by_number( 1 + i * ( ( dictionary_training_blocks - 1 ) / samples ) );
+      if( !b.valid() )
+         continue;
+      const auto data = fc::raw::pack( *b );
+      dictionary.append( data.data(), std::min( data.size(), dictionary_sample_size ) );
+   }
+   if( dictionary.empty() )
+      return;
+
+   const fc::path tmp = _dir / "dictionary.tmp";
+   {
+      std::ofstream out( tmp.generic_string().c_str(), std::ios::binary | std::ios::trunc );
+      out.write( dictionary.data(), dictionary.size() );
+      out.close();
+      FC_ASSERT( out.good(), "Failed to write ${f}", ("f",tmp) );
+   }
+   fc::rename( tmp, _dir / "dictionary" );
+   std::atomic_store( &_dictionary, std::make_shared<const std::string>( std::move(dictionary) ) );
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -67,15 +288,49 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
-   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
+   const uint32_t block_num = block_header::num_from_id(id);
+   auto vec = fc::raw::pack( b );
+   if( _compress )
+   {
+      auto dictionary = std::atomic_load( &_dictionary );
+      if( !dictionary && block_num >= dictionary_training_blocks )
+      {
+         train_dictionary();
+         dictionary = std::atomic_load( &_dictionary );
+      }
+      std::vector<char> record;
+      if( dictionary )
+      {
+         const auto compressed = zlib_compress( vec, *dictionary );
+         const auto raw_size = fc::raw::pack( fc::unsigned_int( vec.size() ) );
+         if( 1 + raw_size.size() + compressed.size() < vec.size() )
+         {
+            record.reserve( 1 + raw_size.size() + compressed.size() );
+            record.push_back( zlib_record );
+            record.insert( record.end(), raw_size.begin(), raw_size.end() );
+            record.insert( record.end(), compressed.begin(), compressed.end() );
+         }
+      }
+      if( record.empty() )
+      {
+         record.reserve( vec.size() + 1 );
+         record.push_back( raw_record );
+         record.insert( record.end(), vec.begin(), vec.end() );
+      }
+      vec = std::move( record );
+   }
+
+   open_segment( segment_of( block_num ) );
+   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_num) );
    index_entry e;
    _blocks.seekp( 0, _blocks.end );
-   auto vec = fc::raw::pack( b );
    e.block_pos  = _blocks.tellp();
    e.block_size = vec.size();
    e.block_id   = id;
    _blocks.write( vec.data(), vec.size() );
    _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   flush_files();
+   _index_size = std::max<uint64_t>( _index_size.load(), sizeof( index_entry ) * ( uint64_t(block_num) + 1 ) );
 }
 
 void block_database::remove( const block_id_type& id )
@@ -94,63 +349,123 @@ void block_database::remove( const block_id_type& id )
       e.block_size = 0;
       _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
       _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      flush_files();
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
-bool block_database::contains( const block_id_type& id )const
+block_database::mapped_file_ptr block_database::map( mapped_file_ptr& current, const fc::path& file,
+                                                     const std::function<uint64_t()>& available,
+                                                     uint64_t needed )const
 {
-   if( id == block_id_type() )
-      return false;
+   mapped_file_ptr result = std::atomic_load( &current );
+   if( result && result->size >= needed )
+      return result;
+   // the file has grown, only one thread maps it again
+   std::lock_guard<std::mutex> guard( _remap_mutex );
+   result = std::atomic_load( &current );
+   if( !result || result->size < needed )
+   {
+      const uint64_t size = available();
+      if( size < needed || size == 0 )
+         return mapped_file_ptr();
+      result = std::make_shared<const mapped_file>( file, mapping_size( size ) );
+      std::atomic_store( &current, result );
+   }
+   return result;
+}
 
+block_database::mapped_file_ptr& block_database::segment_map( uint32_t segment )const
+{
+   std::lock_guard<std::mutex> guard( _remap_mutex );
+   // growing a deque at the end keeps references to the existing slots valid
+   if( _segment_maps.size() <= segment )
+      _segment_maps.resize( segment + 1 );
+   return _segment_maps[segment];
+}
+
+void block_database::clear_segment_maps()
+{
+   std::lock_guard<std::mutex> guard( _remap_mutex );
+   _segment_maps.clear();
+}
+
+optional<index_entry> block_database::read_index_entry( uint32_t block_num )const
+{
+   const uint64_t index_pos = sizeof(index_entry) * uint64_t(block_num);
+   // the mapping may extend beyond the entries written so far
+   if( index_pos + sizeof(index_entry) > _index_size.load() )
+      return optional<index_entry>();
+   const auto index = map( _index_map, _index_filename, [this]() { return _index_size.load(); },
+                           index_pos + sizeof(index_entry) );
+   if( !index )
+      return optional<index_entry>();
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+   std::memcpy( (char*)&e, index->data() + index_pos, sizeof(e) );
+   return e;
+}
+
+optional<signed_block> block_database::read_block( const index_entry& e )const
+{
+   if( e.block_size.value() == 0 )
+      return optional<signed_block>();
+   const uint32_t segment = segment_of( block_header::num_from_id( e.block_id ) );
+   const uint64_t end = e.block_pos.value() + e.block_size.value();
+   // an index entry is only published after the block data has been flushed, so the file is large enough
+   const fc::path file = segment_filename( segment );
+   const auto blocks = map( segment_map( segment ), file,
+                            [&file]() { return fc::exists( file ) ? uint64_t( fc::file_size( file ) ) : uint64_t(0); },
+                            end );
+   if( !blocks )
+      return optional<signed_block>();
+
+   fc::datastream<const char*> ds( blocks->data() + e.block_pos.value(), e.block_size.value() );
+   signed_block result;
+   char type = raw_record;
+   if( _compress )
+      ds.read( &type, 1 );
+   if( type == raw_record )
+      fc::raw::unpack( ds, result );
+   else
+   {
+      FC_ASSERT( type == zlib_record, "Unknown block record type" );
+      const auto dictionary = std::atomic_load( &_dictionary );
+      FC_ASSERT( dictionary, "Compressed block without dictionary" );
+      fc::unsigned_int raw_size;
+      fc::raw::unpack( ds, raw_size );
+      const auto data = zlib_uncompress( ds.pos(), ds.remaining(), raw_size.value, *dictionary );
+      result = fc::raw::unpack<signed_block>( data );
+   }
+   FC_ASSERT( result.id() == e.block_id );
+   return result;
+}
+
+bool block_database::contains( const block_id_type& id )const
+{
+   if( id == block_id_type() )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
-   return e.block_id == id && e.block_size.value() > 0;
+   optional<index_entry> e = read_index_entry( block_header::num_from_id(id) );
+   return e.valid() && e->block_id == id && e->block_size.value() > 0;
 }
 
 block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
-   index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   optional<index_entry> e = read_index_entry( block_num );
+   if( !e.valid() )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-   FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
-   return e.block_id;
+   FC_ASSERT( e->block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
+   return e->block_id;
 }
 
 optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
 {
    try
    {
-      index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
-         return {};
-
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      if( e.block_id != id ) return optional<signed_block>();
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      if (e.block_size.value())
-         _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      optional<index_entry> e = read_index_entry( block_header::num_from_id(id) );
+      if( !e.valid() || e->block_id != id ) return optional<signed_block>();
+      return read_block( *e );
    }
    catch (const fc::exception&)
    {
@@ -165,21 +480,9 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
 {
    try
    {
-      index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
-         return {};
-
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      optional<index_entry> e = read_index_entry( block_num );
+      if( !e.valid() ) return optional<signed_block>();
+      return read_block( *e );
    }
    catch (const fc::exception&)
    {
@@ -193,35 +496,17 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
 optional<index_entry> block_database::last_index_entry()const {
    try
    {
-      index_entry e;
-
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      std::streampos pos = _block_num_to_pos.tellg();
-      if( pos < long(sizeof(index_entry)) )
-         return optional<index_entry>();
-
+      uint64_t pos = _index_size.load();
       pos -= pos % sizeof(index_entry);
-
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
       while( pos > 0 )
       {
          pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size.value() > 0
-                && int64_t(e.block_pos.value() + e.block_size.value()) <= blocks_size )
+         optional<index_entry> e = read_index_entry( pos / sizeof(index_entry) );
+         if( e.valid() && e->block_size.value() > 0 )
             try
             {
-               vector<char> data( e.block_size.value() );
-               _blocks.seekg( e.block_pos.value() );
-               _blocks.read( data.data(), e.block_size.value() );
-               if( _blocks.gcount() == long(e.block_size.value()) )
-               {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
-                     return e;
-               }
+               if( read_block( *e ).valid() )
+                  return e;
             }
             catch (const fc::exception&)
             {
@@ -229,6 +514,9 @@ optional<index_entry> block_database::last_index_entry()const {
             catch (const std::exception&)
             {
             }
+         // drop the broken entry, the readers must not access the truncated part of the old mapping
+         std::atomic_store( &_index_map, mapped_file_ptr() );
+         _index_size = pos;
          fc::resize_file( _index_filename, pos );
       }
    }
@@ -255,15 +543,32 @@ optional<block_id_type> block_database::last_id()const
    return optional<block_id_type>();
 }
 
-size_t block_database::blocks_current_position()const
+size_t block_database::block_end_position( uint32_t block_num )const
 {
-   return (size_t)_blocks.tellg();
+   optional<index_entry> e = read_index_entry( block_num );
+   if( !e.valid() || e->block_size.value() == 0 )
+      return 0;
+   const uint32_t segment = segment_of( block_num );
+   const uint64_t offset = segment < _segment_offsets.size() ? _segment_offsets[segment] : 0;
+   return (size_t)( offset + e->block_pos.value() + e->block_size.value() );
 }
 
 size_t block_database::total_block_size()const
 {
-   _blocks.seekg( 0, _blocks.end );
-   return (size_t)_blocks.tellg();
+   // also remembers where each segment starts, for block_end_position()
+   _segment_offsets.clear();
+   uint64_t total = 0;
+   for( uint32_t segment = 0; ; ++segment )
+   {
+      const fc::path file = segment_filename( segment );
+      if( !fc::exists( file ) )
+         break;
+      _segment_offsets.push_back( total );
+      total += fc::file_size( file );
+      if( _segment_size == 0 )
+         break;
+   }
+   return (size_t)total;
 }
 
 } }
@@ -23,6 +23,9 @@
 #include <fc/io/raw.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <algorithm>
+#include <limits>
+
 namespace graphene { namespace chain {
 
 bool database::is_known_block( const block_id_type& id )const
@@ -105,6 +108,8 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
       [&]()
       {
          result = _push_block(new_block);
+         // pending transactions are not applied at this point, so the undo states on top are those of the blocks
+         checkpoint_irreversible_state();
       });
    });
    return result;
@@ -247,10 +252,27 @@ void database::update_witnesses( fork_item& fork_entry )const
  * queues full as well, it will be kept in the queue to be propagated later when a new block flushes out the pending
  * queues.
  */
-processed_transaction database::push_transaction( const precomputable_transaction& trx, uint32_t skip )
-{ try {
+void database::check_transaction_to_push( const precomputable_transaction& trx )const
+{
    // see https://github.com/acloudbank/acloudbank-core/issues/1573
    FC_ASSERT( fc::raw::pack_size( trx ) < (1024 * 1024), "Transaction exceeds maximum transaction size." );
+   // a block cannot contain a transaction twice, so neither can the pool, whatever the skip flags say
+   GRAPHENE_ASSERT( !_pending_tx.contains( trx.id() ),
+                    duplicate_transaction,
+                    "Transaction '${txid}' is already pending",
+                    ("txid",trx.id()) );
+   if( _max_pending_tx_per_account > 0 )
+   {
+      const account_id_type fee_payer = pending_fee_payer( trx );
+      FC_ASSERT( _pending_tx.count_by_fee_payer( fee_payer ) < _max_pending_tx_per_account,
+                 "Account ${a} already has ${n} pending transactions",
+                 ("a", fee_payer)("n", _max_pending_tx_per_account) );
+   }
+}
+
+processed_transaction database::push_transaction( const precomputable_transaction& trx, uint32_t skip )
+{ try {
+   check_transaction_to_push( trx );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -259,6 +281,33 @@ processed_transaction database::push_transaction( const precomputable_transactio
    return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) } // GCOVR_EXCL_LINE
 
+vector<fc::oexception> database::push_transactions( const vector<precomputable_transaction>& trxs, uint32_t skip )
+{
+   vector<fc::oexception> results( trxs.size() );
+   detail::with_skip_flags( *this, skip, [&]()
+   {
+      if( !_pending_tx_session.valid() )
+         _pending_tx_session = _undo_db.start_undo_session();
+      for( size_t i = 0; i < trxs.size(); ++i )
+      {
+         const precomputable_transaction& trx = trxs[i];
+         try
+         {
+            try
+            {
+               check_transaction_to_push( trx );
+               _push_transaction( trx );
+            } FC_CAPTURE_AND_RETHROW( (trx) )
+         }
+         catch( const fc::exception& e )
+         {
+            results[i] = e;
+         }
+      }
+   } );
+   return results;
+}
+
 processed_transaction database::_push_transaction( const precomputable_transaction& trx )
 {
    // If this is the first transaction pushed after applying a block, start a new undo session.
@@ -273,7 +322,10 @@ processed_transaction database::_push_transaction( const precomputable_transacti
 
    auto temp_session = _undo_db.start_undo_session();
    auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+   pending_transaction pending( processed_trx );
+   pending.skip = get_node_properties().skip_flags;
+   pending.fee_per_kbyte = pending_fee_per_kbyte( pending );
+   _pending_tx.insert( std::move(pending) );
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
@@ -284,6 +336,32 @@ processed_transaction database::_push_transaction( const precomputable_transacti
    return processed_trx;
 }
 
+uint64_t database::pending_fee_per_kbyte( const pending_transaction& pending )const
+{
+   fc::uint128_t core_fees = 0;
+   for( const asset& fee : operation_fees( pending.trx ) )
+   {
+      if( fee.asset_id == asset_id_type() )
+         core_fees += fee.amount.value;
+      else
+      {
+         // only a priority, the fee pool pays the actual fee at a possibly different rate
+         const asset_object* fee_asset = find( fee.asset_id );
+         if( fee_asset != nullptr && !fee_asset->options.core_exchange_rate.is_null() )
+         {
+            const price& cer = fee_asset->options.core_exchange_rate;
+            const auto& to_core = ( cer.base.asset_id == fee.asset_id ) ? cer.quote : cer.base;
+            const auto& from_fee = ( cer.base.asset_id == fee.asset_id ) ? cer.base : cer.quote;
+            if( from_fee.amount > 0 )
+               core_fees += fc::uint128_t( fee.amount.value ) * to_core.amount.value / from_fee.amount.value;
+         }
+      }
+   }
+   const fc::uint128_t result = core_fees * 1024 / std::max<uint64_t>( pending.packed_size, 1 );
+   return result > std::numeric_limits<uint64_t>::max() ? std::numeric_limits<uint64_t>::max()
+                                                        : static_cast<uint64_t>( result );
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
    auto session = _undo_db.start_undo_session();
@@ -387,31 +465,9 @@ signed_block database::_generate_block(
    witness_id_type scheduled_witness = get_scheduled_witness( slot_num );
    FC_ASSERT( scheduled_witness == witness_id );
 
-   //
-   // The following code throws away existing pending_tx_session and
-   // rebuilds it by re-applying pending transactions.
-   //
-   // This rebuild is necessary because pending transactions' validity
-   // and semantics may have changed since they were received, because
-   // time-based semantics are evaluated based on the current block
-   // time.  These changes can only be reflected in the database when
-   // the value of the "when" variable is known, which means we need to
-   // re-apply pending transactions in this method.
-   //
-
-   // pop pending state (reset to head block state)
-   _pending_tx_session.reset();
-
    // Check witness signing key
    if( 0 == (skip & skip_witness_signature) )
-   {
-      // Note: if this check failed (which won't happen in normal situations),
-      // we would have temporarily broken the invariant that
-      // _pending_tx_session is the result of applying _pending_tx.
-      // In this case, when the node received a new block,
-      // the push_block() call will re-create the _pending_tx_session.
       FC_ASSERT( witness_id(*this).signing_key == block_signing_private_key.get_public_key() );
-   }
 
    static const size_t max_partial_block_header_size = ( fc::raw::pack_size( signed_block_header() )
                                                        - fc::raw::pack_size( witness_id_type() ) ) // witness_id
@@ -424,32 +480,53 @@ signed_block database::_generate_block(
 
    signed_block pending_block;
 
-   _pending_tx_session = _undo_db.start_undo_session();
+   //
+   // _pending_tx_session is the result of applying _pending_tx in arrival order on top of the head block.  The
+   // transactions of a block are applied before its timestamp becomes the head block time, so in the new block
+   // they see the same state and the same time as when they were pushed.  Hence if all of them fit into the
+   // block, they can be taken as they are, without applying them again.
+   //
+   // Otherwise the block is filled by priority: the pending state is rebuilt by applying the transactions with
+   // the highest fee per byte first, as long as they fit.  The others stay pending.  The pending state is rebuilt
+   // the same way if a transaction was pushed with checks skipped which are not skipped here, or if the pending
+   // state is gone.
+   //
+   const auto& pending_by_sequence = _pending_tx.get<transaction_pool::by_sequence>();
+   bool rebuild = !_pending_tx_session.valid() && !_pending_tx.empty();
+   for( auto itr = pending_by_sequence.begin(); !rebuild && itr != pending_by_sequence.end(); ++itr )
+   {
+      if( 0 != ( itr->skip & ~skip ) || total_block_size + itr->packed_size > maximum_block_size )
+         rebuild = true;
+      else
+         total_block_size += itr->packed_size;
+   }
 
    uint64_t postponed_tx_count = 0;
-   for( const processed_transaction& tx : _pending_tx )
+   if( !rebuild )
    {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
-
-      // postpone transaction if it would make block too big
-      if( new_total_size > maximum_block_size )
+      pending_block.transactions.reserve( _pending_tx.size() );
+      for( const pending_transaction& pending : pending_by_sequence )
       {
-         postponed_tx_count++;
-         continue;
+         pending_block.transactions.push_back( pending.trx );
+         // Clear results to save disk space and network bandwidth.
+         // This may break client applications which rely on the results.
+         pending_block.transactions.back().operation_results.clear();
       }
+   }
+   else
+   {
+      // pop pending state (reset to head block state)
+      _pending_tx_session.reset();
+      total_block_size = max_block_header_size;
 
-      try
+      _pending_tx_session = _undo_db.start_undo_session();
+
+      for( const pending_transaction& pending : _pending_tx.get<transaction_pool::by_priority>() )
       {
-         auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
-         // Clear results to save disk space and network bandwidth.
-         // This may break client applications which rely on the results.
-         ptx.operation_results.clear();
+         const processed_transaction& tx = pending.trx;
+         // the size does not change when the transaction is applied again, as the results are cleared
+         size_t new_total_size = total_block_size + pending.packed_size;
 
-         // We have to recompute pack_size(ptx) because it may be different
-         // than pack_size(tx) (i.e. if one or more results increased
-         // their size)
-         new_total_size = total_block_size + fc::raw::pack_size( ptx );
          // postpone transaction if it would make block too big
          if( new_total_size > maximum_block_size )
          {
@@ -457,16 +534,25 @@ signed_block database::_generate_block(
             continue;
          }
 
-         temp_session.merge();
+         try
+         {
+            auto temp_session = _undo_db.start_undo_session();
+            processed_transaction ptx = _apply_transaction( tx );
+            // Clear results to save disk space and network bandwidth.
+            // This may break client applications which rely on the results.
+            ptx.operation_results.clear();
 
-         total_block_size = new_total_size;
-         pending_block.transactions.push_back( ptx );
-      }
-      catch ( const fc::exception& e )
-      {
-         // Do nothing, transaction will not be re-applied
-         wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         wlog( "The transaction was ${t}", ("t", tx) );
+            temp_session.merge();
+
+            total_block_size = new_total_size;
+            pending_block.transactions.push_back( ptx );
+         }
+         catch ( const fc::exception& e )
+         {
+            // Do nothing, transaction will not be re-applied
+            wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
+            wlog( "The transaction was ${t}", ("t", tx) );
+         }
       }
    }
    if( postponed_tx_count > 0 )
@@ -474,13 +560,8 @@ signed_block database::_generate_block(
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
    }
 
-   _pending_tx_session.reset();
-
-   // We have temporarily broken the invariant that
-   // _pending_tx_session is the result of applying _pending_tx, as
-   // _pending_tx now consists of the set of postponed transactions.
-   // However, the push_block() call below will re-create the
-   // _pending_tx_session.
+   // push_block() below discards the pending state and applies the remaining pending transactions again on top
+   // of the new block.
 
    pending_block.previous = head_block_id();
    pending_block.timestamp = when;
@@ -705,7 +786,7 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
 
       trx.verify_authority(chain_id, get_active, get_owner, get_custom, allow_non_immediate_owner,
                            MUST_IGNORE_CUSTOM_OP_REQD_AUTHS(head_block_time()),
-                           get_global_properties().parameters.max_authority_depth);
+                           get_global_properties().parameters.max_authority_depth, _authority_cache);
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
@@ -865,7 +946,7 @@ void database::_precompute_parallel( const Trx* trx, const size_t count, const u
    }
 }
 
-fc::future<void> database::precompute_parallel( const signed_block& block, const uint32_t skip )const
+std::vector<fc::future<void>> database::start_precompute( const signed_block& block, const uint32_t skip )const
 { try {
    std::vector<fc::future<void>> workers;
    if( !block.transactions.empty() )
@@ -893,6 +974,12 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
       block.calculate_merkle_root();
    block.id();
 
+   return workers;
+} FC_LOG_AND_RETHROW() }
+
+fc::future<void> database::precompute_parallel( const signed_block& block, const uint32_t skip )const
+{ try {
+   std::vector<fc::future<void>> workers = start_precompute( block, skip );
    if( workers.empty() )
       return fc::future< void >( fc::promise< void >::create( true ) );
 
@@ -910,4 +997,36 @@ fc::future<void> database::precompute_parallel( const precomputable_transaction&
    });
 }
 
+fc::future<void> database::precompute_parallel( const vector<precomputable_transaction>& trxs )const
+{
+   if( trxs.empty() )
+      return fc::future< void >( fc::promise< void >::create( true ) );
+
+   std::vector<fc::future<void>> workers;
+   uint32_t chunks = fc::asio::default_io_service_scope::get_num_threads();
+   size_t chunk_size = ( trxs.size() + chunks - 1 ) / chunks;
+   workers.reserve( chunks );
+   for( size_t base = 0; base < trxs.size(); base += chunk_size )
+      workers.push_back( fc::do_parallel( [this,&trxs,base,chunk_size] () {
+         const size_t end = std::min( base + chunk_size, trxs.size() );
+         for( size_t i = base; i < end; ++i )
+         {
+            try
+            {
+               _precompute_parallel( &trxs[i], 1, skip_nothing );
+            }
+            catch( const fc::exception& )
+            {
+               // the transaction is invalid, pushing it reports why
+            }
+         }
+      }) );
+
+   auto first = workers.begin();
+   auto worker = first;
+   while( ++worker != workers.end() )
+      worker->wait();
+   return *first;
+}
+
 } }
@@ -83,21 +83,21 @@ vector<authority> database::get_viable_custom_authorities(
    const auto& index = get_index_type<custom_authority_index>().indices().get<by_account_custom>();
    auto range = index.equal_range(boost::make_tuple(account, unsigned_int(op.which()), true));
 
-   auto is_valid = [now=head_block_time()](const custom_authority_object& auth) { return auth.is_valid(now); };
-   vector<std::reference_wrapper<const custom_authority_object>> valid_auths;
-   std::copy_if(range.first, range.second, std::back_inserter(valid_auths), is_valid);
-
+   const auto now = head_block_time();
    vector<authority> results;
-   for (const auto& cust_auth : valid_auths) {
+   for (auto itr = range.first; itr != range.second; ++itr) {
+      const custom_authority_object& cust_auth = *itr;
+      if (!cust_auth.is_valid(now))
+         continue;
       try {
-         auto result = cust_auth.get().get_predicate()(op);
+         auto result = cust_auth.get_predicate()(op);
          if (result.success)
-            results.emplace_back(cust_auth.get().auth);
+            results.emplace_back(cust_auth.auth);
          else if (rejected_authorities != nullptr)
-            rejected_authorities->insert(std::make_pair(cust_auth.get().get_id(), std::move(result)));
+            rejected_authorities->insert(std::make_pair(cust_auth.get_id(), std::move(result)));
       } catch (fc::exception& e) {
          if (rejected_authorities != nullptr)
-            rejected_authorities->insert(std::make_pair(cust_auth.get().get_id(), std::move(e)));
+            rejected_authorities->insert(std::make_pair(cust_auth.get_id(), std::move(e)));
       }
    }
 
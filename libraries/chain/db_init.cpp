@@ -158,18 +158,23 @@ void database::initialize_indexes()
    add_index< primary_index<asset_index, 13> >(); // 8192 assets per chunk
    add_index< primary_index<force_settlement_index> >();
 
-   add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
+   auto acnt_index = add_index< primary_index<account_index, 20> >(); // ~1 million accounts per chunk
+   acnt_index->add_secondary_index<account_vote_change_index>();
+   _authority_cache = acnt_index->add_secondary_index<account_authority_cache>();
    add_index< primary_index<committee_member_index, 8> >(); // 256 members per chunk
    add_index< primary_index<witness_index, 10> >(); // 1024 witnesses per chunk
-   add_index< primary_index<limit_order_index > >();
+   auto limit_order_idx = add_index< primary_index<limit_order_index > >();
+   limit_order_idx->add_secondary_index<limit_order_book_index>();
+   limit_order_idx->add_secondary_index<limit_order_expiration_index>();
    add_index< primary_index<call_order_index > >();
-   add_index< primary_index<proposal_index > >();
-   add_index< primary_index<withdraw_permission_index > >();
+   add_index< primary_index<proposal_index > >()->add_secondary_index<proposal_expiration_index>();
+   add_index< primary_index<withdraw_permission_index > >()
+      ->add_secondary_index<withdraw_permission_expiration_index>();
    add_index< primary_index<vesting_balance_index> >();
    add_index< primary_index<worker_index> >();
    add_index< primary_index<balance_index> >();
    add_index< primary_index<blinded_balance_index> >();
-   add_index< primary_index< htlc_index> >();
+   add_index< primary_index< htlc_index> >()->add_secondary_index<htlc_expiration_index>();
    add_index< primary_index< custom_authority_index> >();
 
    add_index< primary_index<tank_index> >();
@@ -180,16 +185,21 @@ void database::initialize_indexes()
    add_index< primary_index<credit_deal_index> >();
 
    //Implementation object indexes
-   add_index< primary_index<transaction_index                             > >();
+   add_index< primary_index<transaction_index                             > >()
+      ->add_secondary_index<transaction_expiration_index>();
 
    auto bal_idx = add_index< primary_index<account_balance_index          > >();
    bal_idx->add_secondary_index<balances_by_account_index>();
+   bal_idx->set_delta_undo( true );
 
    add_index< primary_index<asset_bitasset_data_index,                 13 > >(); // 8192
    add_index< primary_index<simple_index<global_property_object          >> >();
-   add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<account_stats_index,                       20 > >(); // 1 Mi
-   add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
+   // These are modified by nearly every block but only in a few fields, keep undo history as deltas
+   add_index< primary_index<simple_index<dynamic_global_property_object  >> >()->set_delta_undo( true );
+   auto stats_idx = add_index< primary_index<account_stats_index,      20 > >(); // 1 Mi
+   stats_idx->add_secondary_index<account_statistics_vote_change_index>();
+   stats_idx->set_delta_undo( true );
+   add_index< primary_index<simple_index<asset_dynamic_data_object       >> >()->set_delta_undo( true );
    add_index< primary_index<simple_index<block_summary_object            >> >();
    add_index< primary_index<simple_index<chain_property_object          > > >();
    add_index< primary_index<simple_index<witness_schedule_object        > > >();
@@ -2,6 +2,7 @@
  * Acloudbank
  */
 
+#include <fc/thread/parallel.hpp>
 #include <fc/uint128.hpp>
 
 #include <graphene/protocol/market.hpp>
@@ -34,23 +35,38 @@ template<class Index>
 vector<std::reference_wrapper<const typename Index::object_type>> database::sort_votable_objects(size_t count) const
 {
    using ObjectType = typename Index::object_type;
-   const auto& all_objects = get_index_type<Index>().indices();
-   count = std::min(count, all_objects.size());
-   vector<std::reference_wrapper<const ObjectType>> refs;
-   refs.reserve(all_objects.size());
-   std::transform(all_objects.begin(), all_objects.end(),
-                  std::back_inserter(refs),
-                  [](const ObjectType& o) { return std::cref(o); });
-   std::partial_sort(refs.begin(), refs.begin() + count, refs.end(),
-                   [this](const ObjectType& a, const ObjectType& b)->bool {
+   const auto& by_vote = get_index_type<Index>().indices().template get<by_vote_id>();
+   count = std::min(count, by_vote.size());
+   auto more_votes = [this](const ObjectType& a, const ObjectType& b)->bool {
       share_type oa_vote = _vote_tally_buffer[a.vote_id];
       share_type ob_vote = _vote_tally_buffer[b.vote_id];
       if( oa_vote != ob_vote )
          return oa_vote > ob_vote;
       return a.vote_id < b.vote_id;
-   });
+   };
 
-   refs.resize(count, refs.front());
+   // Only the objects voted for during the tally are ranked, the rest have no votes and follow by vote ID
+   vector<std::reference_wrapper<const ObjectType>> refs;
+   vote_id_type vote_id; // vote IDs compare by instance only
+   for( uint32_t instance : _voted_vote_ids )
+   {
+      vote_id = instance;
+      auto itr = by_vote.find( vote_id );
+      if( itr != by_vote.end() )
+         refs.emplace_back( *itr );
+   }
+   if( refs.size() > count )
+   {
+      std::partial_sort( refs.begin(), refs.begin() + count, refs.end(), more_votes );
+      refs.resize( count, refs.front() );
+      return refs;
+   }
+   std::sort( refs.begin(), refs.end(), more_votes );
+   for( auto itr = by_vote.begin(); itr != by_vote.end() && refs.size() < count; ++itr )
+   {
+      if( _vote_tally_buffer[itr->vote_id] == 0 )
+         refs.emplace_back( *itr );
+   }
    return refs;
 }
 
@@ -78,6 +94,8 @@ void database::perform_account_maintenance(Type tally_helper)
    }
 
    const auto& stats_idx = get_index_type< account_stats_index >().indices().get< by_maintenance_seq >();
+   // Tallying does not change what the other accounts tally, so their votes can be computed up front
+   tally_helper.precompute( stats_idx );
    auto stats_itr = stats_idx.lower_bound( true );
 
    while( stats_itr != stats_idx.end() )
@@ -92,6 +110,8 @@ void database::perform_account_maintenance(Type tally_helper)
       if( acc_stat.has_pending_fees() )
          acc_stat.process_fees( acc_obj, *this );
    }
+   FC_ASSERT( tally_helper.all_precomputed_applied(), "Internal error" ); // Normally it should not fail
+   tally_helper.check_recount();
 
 }
 
@@ -122,11 +142,17 @@ void database::update_worker_votes()
    bool allow_negative_votes = (head_block_time() < HARDFORK_607_TIME);
    while( itr != itr_end )
    {
-      modify( *itr, [this,allow_negative_votes]( worker_object& obj )
+      const uint64_t votes_for = _vote_tally_buffer[itr->vote_for];
+      const uint64_t votes_against = allow_negative_votes ? _vote_tally_buffer[itr->vote_against] : 0;
+      // most workers keep their votes, leave those alone
+      if( itr->total_votes_for != votes_for || itr->total_votes_against != votes_against )
       {
-         obj.total_votes_for = _vote_tally_buffer[obj.vote_for];
-         obj.total_votes_against = allow_negative_votes ? _vote_tally_buffer[obj.vote_against] : 0;
-      });
+         modify( *itr, [votes_for,votes_against]( worker_object& obj )
+         {
+            obj.total_votes_for = votes_for;
+            obj.total_votes_against = votes_against;
+         });
+      }
       ++itr;
    }
 }
@@ -211,6 +237,8 @@ void database::update_active_witnesses()
    const global_property_object& gpo = get_global_properties();
 
    auto update_witness_total_votes = [this]( const witness_object& wit ) {
+      if( wit.total_votes == _vote_tally_buffer[wit.vote_id] )
+         return;
       modify( wit, [this]( witness_object& obj )
       {
          obj.total_votes = _vote_tally_buffer[obj.vote_id];
@@ -314,6 +342,8 @@ void database::update_active_committee_members()
    auto committee_members = sort_votable_objects<committee_member_index>( committee_member_count );
 
    auto update_committee_member_total_votes = [this]( const committee_member_object& cm ) {
+      if( cm.total_votes == _vote_tally_buffer[cm.vote_id] )
+         return;
       modify( cm, [this]( committee_member_object& obj )
       {
          obj.total_votes = _vote_tally_buffer[obj.vote_id];
@@ -1232,6 +1262,25 @@ void database::perform_chain_maintenance( const signed_block& next_block )
    distribute_fba_balances(*this);
    create_buyback_orders(*this);
 
+   struct precomputed_tally_entry {
+      explicit precomputed_tally_entry( const account_statistics_object* s ) : stats( s ) {}
+      const account_statistics_object* stats;
+      bool valid = false; ///< Whether the account adds to the tally
+      vote_tally_entry entry;
+   };
+
+   /// The part of the tally computed by one thread
+   struct vote_tally_shard {
+      vote_tally_shard( size_t num_votes, size_t num_witness_counts, size_t num_committee_counts )
+         : votes( num_votes, 0 ), witness_count_histogram( num_witness_counts, 0 ),
+           committee_count_histogram( num_committee_counts, 0 ) {}
+      vector<uint64_t> votes;
+      vector<uint32_t> voted_vote_ids;
+      vector<uint64_t> witness_count_histogram;
+      vector<uint64_t> committee_count_histogram;
+      std::array<uint64_t,2> total_voting_stake = {}; // 0=committee, 1=witness
+   };
+
    struct vote_tally_helper {
       database& d;
       const global_property_object& props;
@@ -1250,13 +1299,31 @@ void database::perform_chain_maintenance( const signed_block& next_block )
       optional<detail::vote_recalc_times> worker_recalc_times;
       optional<detail::vote_recalc_times> delegator_recalc_times;
 
+      /// Accounts tallied in parallel, in the order they are passed to operator()
+      vector<precomputed_tally_entry> precomputed;
+      size_t next_precomputed = 0;
+      /// Tallying in parallel only pays off with enough accounts per thread
+      const size_t min_accounts_per_thread = 1000;
+
+      /// Whether what the accounts added to the last tally is reused, see @ref vote_tally_cache
+      bool use_cache = false;
+      /// Whether all accounts are computed again to check the cache
+      bool recount = false;
+      const account_vote_change_index& account_changes;
+      const account_statistics_vote_change_index& stats_changes;
+
       explicit vote_tally_helper( database& db )
          : d(db), props( d.get_global_properties() ), dprops( d.get_dynamic_global_properties() ),
            now( d.head_block_time() ), hf2103_passed( HARDFORK_CORE_2103_PASSED( now ) ),
            hf2262_passed( HARDFORK_CORE_2262_PASSED( now ) ),
-           pob_activated( dprops.total_pob > 0 || dprops.total_inactive > 0 )
+           pob_activated( dprops.total_pob > 0 || dprops.total_inactive > 0 ),
+           account_changes( d.get_index_type< primary_index<account_index> >()
+                              .get_secondary_index<account_vote_change_index>() ),
+           stats_changes( d.get_index_type< primary_index<account_stats_index> >()
+                              .get_secondary_index<account_statistics_vote_change_index>() )
       {
          d._vote_tally_buffer.resize( props.next_available_vote_id, 0 );
+         d._voted_vote_ids.clear();
          d._witness_count_histogram_buffer.resize( (props.parameters.maximum_witness_count / two) + 1, 0 );
          d._committee_count_histogram_buffer.resize( (props.parameters.maximum_committee_count / two) + 1, 0 );
          d._total_voting_stake[vid_committee] = 0;
@@ -1268,13 +1335,27 @@ void database::perform_chain_maintenance( const signed_block& next_block )
             worker_recalc_times    = detail::vote_recalc_options::worker().get_vote_recalc_times( now );
             delegator_recalc_times = detail::vote_recalc_options::delegator().get_vote_recalc_times( now );
          }
+         // Before core-2262 the cashback balance votes, and changes of it are not tracked
+         use_cache = hf2262_passed && d._vote_tally_cache.enabled();
+         if( use_cache )
+         {
+            vote_tally_cache::context_type context;
+            context.pob_activated = pob_activated;
+            context.hf2103_passed = hf2103_passed;
+            context.count_non_member_votes = props.parameters.count_non_member_votes;
+            recount = d._vote_tally_cache.start_tally( context,
+                                                       d.get_index_type<account_index>().get_next_id().instance() );
+         }
       }
 
-      void operator()( const account_object& stake_account, const account_statistics_object& stats )
+      /// Computes what @p stake_account adds to the tally, without changing the database
+      /// @return false if it adds nothing
+      bool compute( const account_object& stake_account, const account_statistics_object& stats,
+                    vote_tally_entry& entry )const
       {
          // PoB activation
          if( pob_activated && stats.total_core_pob == 0 && stats.total_core_inactive == 0 )
-            return;
+            return false;
 
          if( props.parameters.count_non_member_votes || stake_account.is_member( now ) )
          {
@@ -1348,7 +1429,7 @@ void database::perform_chain_maintenance( const signed_block& next_block )
 
             // Shortcut
             if( 0 == voting_stake[vid_worker] )
-               return;
+               return false;
 
             const auto& opinion_account_stats = ( directly_voting ? stats : opinion_account.statistics( d ) );
 
@@ -1388,55 +1469,263 @@ void database::perform_chain_maintenance( const signed_block& next_block )
                vp_worker = voting_stake[vid_worker];
             }
 
-            // update voting power
-            d.modify( opinion_account_stats, [vp_all,vp_active,vp_committee,vp_witness,vp_worker,this]
-                                             ( account_statistics_object& update_stats ) {
-               if (update_stats.vote_tally_time != now)
-               {
-                  update_stats.vp_all = vp_all;
-                  update_stats.vp_active = vp_active;
-                  update_stats.vp_committee = vp_committee;
-                  update_stats.vp_witness = vp_witness;
-                  update_stats.vp_worker = vp_worker;
-                  update_stats.vote_tally_time = now;
-               }
-               else
-               {
-                  update_stats.vp_all += vp_all;
-                  update_stats.vp_active += vp_active;
-                  update_stats.vp_committee += vp_committee;
-                  update_stats.vp_witness += vp_witness;
-                  update_stats.vp_worker += vp_worker;
-               }
-            });
+            entry.opinion_account = &opinion_account;
+            entry.opinion_account_stats = &opinion_account_stats;
+            entry.voting_stake = voting_stake;
+            entry.num_committee_voting_stake = num_committee_voting_stake;
+            entry.vp_all = vp_all;
+            entry.vp_active = vp_active;
+            entry.vp_committee = vp_committee;
+            entry.vp_witness = vp_witness;
+            entry.vp_worker = vp_worker;
+            return true;
+         }
+         return false;
+      }
+
+      /// @return the recalculation step a vote cast at @p last_vote_time is in, 0 for full voting power
+      static uint8_t recalc_step( const detail::vote_recalc_options& options, const time_point_sec last_vote_time,
+                                  const detail::vote_recalc_times& recalc_times )
+      {
+         if( last_vote_time > recalc_times.full_power_time )
+            return 0;
+         if( last_vote_time <= recalc_times.zero_power_time )
+            return static_cast<uint8_t>( options.recalc_steps );
+         uint32_t diff = recalc_times.full_power_time.sec_since_epoch() - last_vote_time.sec_since_epoch();
+         return static_cast<uint8_t>( 1 + diff / options.seconds_per_step );
+      }
+
+      std::array<uint8_t,4> recalc_steps( const time_point_sec stake_last_vote_time,
+                                          const time_point_sec opinion_last_vote_time )const
+      {
+         std::array<uint8_t,4> steps = {};
+         if( !hf2103_passed )
+            return steps;
+         steps[0] = recalc_step( detail::vote_recalc_options::witness(), opinion_last_vote_time,
+                                 *witness_recalc_times );
+         steps[1] = recalc_step( detail::vote_recalc_options::committee(), opinion_last_vote_time,
+                                 *committee_recalc_times );
+         steps[2] = recalc_step( detail::vote_recalc_options::worker(), opinion_last_vote_time,
+                                 *worker_recalc_times );
+         steps[3] = recalc_step( detail::vote_recalc_options::delegator(), stake_last_vote_time,
+                                 *delegator_recalc_times );
+         return steps;
+      }
+
+      /**
+       * Like compute(), but takes what @p stake_account added to the last tally if nothing it depends on changed
+       * since.  Safe to call from several threads for different accounts.
+       */
+      bool compute_cached( const account_object& stake_account, const account_statistics_object& stats,
+                           vote_tally_entry& entry )const
+      {
+         cached_vote_tally_entry* cached = use_cache ? d._vote_tally_cache.find( stake_account.get_id() ) : nullptr;
+         if( cached == nullptr )
+            return compute( stake_account, stats, entry );
+
+         const uint64_t instance = stake_account.id.instance();
+         const bool member = stake_account.is_member( now );
+         const uint32_t account_version = account_changes.version( instance );
+         const uint32_t stats_version = stats_changes.version( instance );
+         bool current = ( cached->valid && cached->member == member && cached->account_version == account_version
+                          && cached->stats_version == stats_version );
+         if( current && cached->adds )
+         {
+            const uint64_t opinion_instance = cached->opinion_account.instance.value;
+            current = ( cached->opinion_account_version == account_changes.version( opinion_instance )
+                        && cached->opinion_stats_version == stats_changes.version( opinion_instance )
+                        && cached->recalc_steps == recalc_steps( cached->stake_last_vote_time,
+                                                                 cached->opinion_last_vote_time ) );
+         }
+         if( current && !recount )
+         {
+            if( cached->adds )
+               entry = cached->entry;
+            return cached->adds;
+         }
+
+         const bool adds = compute( stake_account, stats, entry );
+         if( current && ( adds != cached->adds || ( adds && !( entry == cached->entry ) ) ) )
+            d._vote_tally_cache.report_mismatch();
 
-            for( vote_id_type id : opinion_account.options.votes )
+         cached->valid = true;
+         cached->adds = adds;
+         cached->member = member;
+         cached->account_version = account_version;
+         cached->stats_version = stats_version;
+         if( adds )
+         {
+            const uint64_t opinion_instance = entry.opinion_account->id.instance();
+            cached->opinion_account = entry.opinion_account->get_id();
+            cached->opinion_account_version = account_changes.version( opinion_instance );
+            cached->opinion_stats_version = stats_changes.version( opinion_instance );
+            cached->stake_last_vote_time = stats.last_vote_time;
+            cached->opinion_last_vote_time = entry.opinion_account_stats->last_vote_time;
+            cached->recalc_steps = recalc_steps( cached->stake_last_vote_time, cached->opinion_last_vote_time );
+            cached->entry = entry;
+         }
+         return adds;
+      }
+
+      /// Updates the voting power of the opinion account of @p entry
+      void update_voting_power( const vote_tally_entry& entry )const
+      {
+         d.modify( *entry.opinion_account_stats, [&entry,this]( account_statistics_object& update_stats ) {
+            if (update_stats.vote_tally_time != now)
+            {
+               update_stats.vp_all = entry.vp_all;
+               update_stats.vp_active = entry.vp_active;
+               update_stats.vp_committee = entry.vp_committee;
+               update_stats.vp_witness = entry.vp_witness;
+               update_stats.vp_worker = entry.vp_worker;
+               update_stats.vote_tally_time = now;
+            }
+            else
             {
-               uint32_t offset = id.instance();
-               uint32_t type = std::min( id.type(), vote_id_type::vote_type::worker ); // cap the data
-               // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset < d._vote_tally_buffer.size() )
-                  d._vote_tally_buffer[offset] += voting_stake[type];
+               update_stats.vp_all += entry.vp_all;
+               update_stats.vp_active += entry.vp_active;
+               update_stats.vp_committee += entry.vp_committee;
+               update_stats.vp_witness += entry.vp_witness;
+               update_stats.vp_worker += entry.vp_worker;
             }
+         });
+      }
 
-            // votes for a number greater than maximum_witness_count are skipped here
-            if( voting_stake[vid_witness] > 0
-                  && opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
+      /// Adds the votes of @p entry to the given buffers
+      void add( const vote_tally_entry& entry, vector<uint64_t>& votes, vector<uint32_t>& voted_vote_ids,
+                vector<uint64_t>& witness_count_histogram, vector<uint64_t>& committee_count_histogram,
+                std::array<uint64_t,2>& total_voting_stake )const
+      {
+         const account_object& opinion_account = *entry.opinion_account;
+         const auto& voting_stake = entry.voting_stake;
+         for( vote_id_type id : opinion_account.options.votes )
+         {
+            uint32_t offset = id.instance();
+            uint32_t type = std::min( id.type(), vote_id_type::vote_type::worker ); // cap the data
+            // if they somehow managed to specify an illegal offset, ignore it.
+            if( offset < votes.size() && voting_stake[type] > 0 )
             {
-               uint16_t offset = opinion_account.options.num_witness / two;
-               d._witness_count_histogram_buffer[offset] += voting_stake[vid_witness];
+               if( votes[offset] == 0 )
+                  voted_vote_ids.push_back( offset );
+               votes[offset] += voting_stake[type];
             }
-            // votes for a number greater than maximum_committee_count are skipped here
-            if( num_committee_voting_stake > 0
-                  && opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
+         }
+
+         // votes for a number greater than maximum_witness_count are skipped here
+         if( voting_stake[vid_witness] > 0
+               && opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
+         {
+            uint16_t offset = opinion_account.options.num_witness / two;
+            witness_count_histogram[offset] += voting_stake[vid_witness];
+         }
+         // votes for a number greater than maximum_committee_count are skipped here
+         if( entry.num_committee_voting_stake > 0
+               && opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
+         {
+            uint16_t offset = opinion_account.options.num_committee / two;
+            committee_count_histogram[offset] += entry.num_committee_voting_stake;
+         }
+
+         total_voting_stake[vid_committee] += entry.num_committee_voting_stake;
+         total_voting_stake[vid_witness] += voting_stake[vid_witness];
+      }
+
+      /**
+       * Computes the entries of the voting accounts among @p stats on the thread pool, each thread adding the
+       * votes to its own shard, and merges the shards into the database buffers.  The accounts are then passed
+       * to operator() in the same order, which only updates their voting power.
+       */
+      void precompute( const account_stats_multi_index_type::index<by_maintenance_seq>::type& stats )
+      {
+         // Before core-2262 the cashback balance votes, and process_fees() of an account may change the cashback
+         // balance of an account that is tallied after it
+         if( !hf2262_passed )
+            return;
+         const size_t num_threads = fc::asio::default_io_service_scope::get_num_threads();
+         if( num_threads < 2 )
+            return;
+
+         for( auto itr = stats.lower_bound( true ); itr != stats.end(); ++itr )
+         {
+            if( itr->has_some_core_voting() )
+               precomputed.emplace_back( &*itr );
+         }
+         if( precomputed.size() < num_threads * min_accounts_per_thread )
+         {
+            precomputed.clear();
+            return;
+         }
+
+         const size_t chunk_size = ( precomputed.size() + num_threads - 1 ) / num_threads;
+         vector<vote_tally_shard> shards;
+         shards.reserve( num_threads );
+         std::vector<fc::future<void>> workers;
+         workers.reserve( num_threads );
+         for( size_t base = 0; base < precomputed.size(); base += chunk_size )
+         {
+            shards.emplace_back( d._vote_tally_buffer.size(), d._witness_count_histogram_buffer.size(),
+                                 d._committee_count_histogram_buffer.size() );
+            vote_tally_shard& shard = shards.back();
+            const size_t last = std::min( base + chunk_size, precomputed.size() );
+            workers.push_back( fc::do_parallel( [this,base,last,&shard] () {
+               for( size_t i = base; i < last; ++i )
+               {
+                  precomputed_tally_entry& p = precomputed[i];
+                  p.valid = compute_cached( p.stats->owner( d ), *p.stats, p.entry );
+                  if( p.valid )
+                     add( p.entry, shard.votes, shard.voted_vote_ids, shard.witness_count_histogram,
+                          shard.committee_count_histogram, shard.total_voting_stake );
+               }
+            }) );
+         }
+         for( auto& worker : workers )
+            worker.wait();
+
+         for( const auto& shard : shards )
+         {
+            for( uint32_t i : shard.voted_vote_ids )
             {
-               uint16_t offset = opinion_account.options.num_committee / two;
-               d._committee_count_histogram_buffer[offset] += num_committee_voting_stake;
+               if( d._vote_tally_buffer[i] == 0 )
+                  d._voted_vote_ids.push_back( i );
+               d._vote_tally_buffer[i] += shard.votes[i];
             }
+            for( size_t i = 0; i < shard.witness_count_histogram.size(); ++i )
+               d._witness_count_histogram_buffer[i] += shard.witness_count_histogram[i];
+            for( size_t i = 0; i < shard.committee_count_histogram.size(); ++i )
+               d._committee_count_histogram_buffer[i] += shard.committee_count_histogram[i];
+            d._total_voting_stake[vid_committee] += shard.total_voting_stake[vid_committee];
+            d._total_voting_stake[vid_witness] += shard.total_voting_stake[vid_witness];
+         }
+      }
 
-            d._total_voting_stake[vid_committee] += num_committee_voting_stake;
-            d._total_voting_stake[vid_witness] += voting_stake[vid_witness];
+      void operator()( const account_object& stake_account, const account_statistics_object& stats )
+      {
+         if( next_precomputed < precomputed.size() && precomputed[next_precomputed].stats == &stats )
+         {
+            // votes are in the buffers already
+            const precomputed_tally_entry& p = precomputed[next_precomputed++];
+            if( p.valid )
+               update_voting_power( p.entry );
+            return;
          }
+         // not precomputed, or it started voting during this maintenance, e.g. by receiving cashback
+         vote_tally_entry entry;
+         if( !compute_cached( stake_account, stats, entry ) )
+            return;
+         update_voting_power( entry );
+         add( entry, d._vote_tally_buffer, d._voted_vote_ids, d._witness_count_histogram_buffer,
+              d._committee_count_histogram_buffer, d._total_voting_stake );
+      }
+
+      /// @return whether all precomputed accounts have been passed to operator()
+      bool all_precomputed_applied()const { return next_precomputed == precomputed.size(); }
+
+      /// Reports entries of the cache that a recount found to be stale although nothing they depend on changed
+      void check_recount()const
+      {
+         if( recount && d._vote_tally_cache.mismatch_count() > 0 )
+            elog( "Recounting the votes found ${n} accounts whose cached votes were stale",
+                  ("n",d._vote_tally_cache.mismatch_count()) );
       }
    };
 
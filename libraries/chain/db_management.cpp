@@ -13,11 +13,18 @@
 
 #include <fc/io/fstream.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
-#include <queue>
-#include <tuple>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 namespace graphene { namespace chain {
 
@@ -32,6 +39,104 @@ database::~database()
    clear_pending();
 }
 
+namespace {
+   /**
+    *  Queue between the thread reading the blocks and the one applying them.  The consumer works on the front item
+    *  in place and pops it when done, the producer blocks while the queue holds as many items as its current limit.
+    */
+   template<typename T>
+   class replay_queue
+   {
+      public:
+         /// Waits until fewer than limit() items are queued
+         /// @return false if the queue has been closed, @p item is dropped then
+         template<typename Limit>
+         bool push( T&& item, const Limit& limit )
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _not_full.wait( lock, [this,&limit]() { return _closed || _items.size() < limit(); } );
+            if( _closed )
+               return false;
+            _items.push_back( std::move( item ) );
+            _not_empty.notify_one();
+            return true;
+         }
+
+         /// Waits for an item, the reference stays valid until pop()
+         /// @return the oldest item
+         T& front()
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            _not_empty.wait( lock, [this]() { return !_items.empty(); } );
+            return _items.front();
+         }
+
+         void pop()
+         {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _items.pop_front();
+            _not_full.notify_one();
+         }
+
+         bool empty()const
+         {
+            std::lock_guard<std::mutex> lock( _mutex );
+            return _items.empty();
+         }
+
+         /// Wakes up a waiting producer to check its limit again
+         void limit_raised()
+         {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _not_full.notify_one();
+         }
+
+         /// Makes push() fail from now on
+         void close()
+         {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _closed = true;
+            _not_full.notify_all();
+         }
+
+      private:
+         std::deque<T>           _items;
+         mutable std::mutex      _mutex;
+         std::condition_variable _not_full;
+         std::condition_variable _not_empty;
+         bool                    _closed = false;
+   };
+
+   struct replay_item
+   {
+      std::unique_ptr<signed_block> block; ///< nullptr if the block does not exist, ends the replay
+      uint32_t                      skip = 0;
+      size_t                        position = 0;
+      std::vector<fc::future<void>> precomputed;
+      std::exception_ptr            error;
+
+      bool precompute_ready()const
+      {
+         return std::all_of( precomputed.begin(), precomputed.end(),
+                             []( const fc::future<void>& f ) { return f.ready(); } );
+      }
+
+      /// Waits for all precomputations, rethrows the first failure unless @p ignore_errors
+      void wait_precompute( bool ignore_errors = false )
+      {
+         for( fc::future<void>& f : precomputed )
+         {
+            if( ignore_errors )
+            {
+               try { f.wait(); } catch( ... ) {}
+            }
+            else
+               f.wait();
+         }
+      }
+   };
+}
+
 void database::reindex( fc::path data_dir )
 { try {
    auto last_block = _block_id_to_block.last();
@@ -56,92 +161,188 @@ void database::reindex( fc::path data_dir )
    else
       _undo_db.disable();
 
-   uint32_t skip = node_properties().skip_flags;
+   const uint32_t skip = node_properties().skip_flags;
 
    size_t total_block_size = _block_id_to_block.total_block_size();
-   const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
-   uint32_t next_block_num = head_block_num() + 1;
-   uint32_t i = next_block_num;
-   while( next_block_num <= last_block_num || !blocks.empty() )
-   {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+   const fc::time_point_sec dupe_check_start = last_block->timestamp
+                                               - get_global_properties().parameters.maximum_time_until_expiration;
+
+   // The replay is a pipeline: a reader thread fetches and deserializes the blocks in order and starts the
+   // signature, merkle root and transaction ID computations in the thread pool without waiting for them, this
+   // thread waits for them and applies the blocks.  The reader stays up to "depth" blocks ahead, the depth grows
+   // whenever the precomputation of the next block has not finished in time.
+   const size_t max_depth = std::max<uint32_t>( _replay_lookahead, 1 );
+   replay_queue<replay_item> queue;
+   std::atomic<size_t> depth( std::min<size_t>( 20, max_depth ) );
+   std::atomic<bool> stop( false );
+   const uint32_t first_block_num = head_block_num() + 1;
+
+   std::thread reader( [this,&queue,&depth,&stop,skip,dupe_check_start,first_block_num,last_block_num]() {
+      uint32_t block_skip = skip;
+      for( uint32_t num = first_block_num; num <= last_block_num && !stop; ++num )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num );
-         ++next_block_num;
-         if( block.valid() )
-         {
-            if( block->timestamp >= (last_block->timestamp - gpo.parameters.maximum_time_until_expiration) )
-               skip &= (uint32_t)(~skip_transaction_dupe_check);
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
-         }
-         else
+         replay_item item;
+         try
          {
-            wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-            uint32_t dropped_count = 0;
-            while( true )
+            fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( num );
+            if( block.valid() )
             {
-               fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-               // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-               // OR
-               // we've caught up to the gap
-               if( !last_id.valid() || block_header::num_from_id( *last_id ) <= i )
-                  break;
-               _block_id_to_block.remove( *last_id );
-               ++dropped_count;
+               if( block->timestamp >= dupe_check_start )
+                  block_skip &= (uint32_t)(~skip_transaction_dupe_check);
+               item.skip = block_skip;
+               item.position = _block_id_to_block.block_end_position( num );
+               item.block = std::make_unique<signed_block>( std::move(*block) );
+               item.precomputed = start_precompute( *item.block, block_skip );
             }
-            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-            next_block_num = last_block_num + 1; // don't load more blocks
          }
-      }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
-
-         if( i % 10000 == 0 )
+         catch( ... )
          {
-            std::stringstream bysize;
-            std::stringstream bynum;
-            size_t current_pos = std::get<0>(blocks.front());
-            if( current_pos > total_block_size )
-               total_block_size = current_pos;
-            bysize << std::fixed << std::setprecision(5) << (100 * double(current_pos) / total_block_size);
-            bynum << std::fixed << std::setprecision(5) << (100 * double(i) / last_block_num);
-            ilog(
-               "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]",
-               ("size", bysize.str())
-               ("processed", current_pos)
-               ("total", total_block_size)
-               ("num", bynum.str())
-               ("i", i)
-               ("last", last_block_num)
-            );
+            item.error = std::current_exception();
          }
-         if( i == undo_point )
+         const bool done = !item.block;
+         if( !queue.push( std::move(item), [&depth]() { return depth.load(); } ) )
          {
-            ilog( "Writing object database to disk at block ${i}, please DO NOT kill the program", ("i", i) );
-            flush();
-            ilog( "Done writing object database to disk" );
+            // closed, the item was not queued, so wait for the precomputations referring to its block here
+            item.wait_precompute( true );
+            return;
          }
-         if( i < undo_point )
-            apply_block( block, skip );
-         else
+         if( done )
+            return;
+      }
+   });
+   // stops the reader and waits for the pending precomputations, which refer to the queued blocks
+   auto stop_reader = [&queue,&stop,&reader]() {
+      stop = true;
+      queue.close();
+      if( reader.joinable() )
+         reader.join();
+      while( !queue.empty() )
+      {
+         queue.front().wait_precompute( true );
+         queue.pop();
+      }
+   };
+   struct reader_guard
+   {
+      std::function<void()> f;
+      ~reader_guard() { f(); }
+   } guard{ stop_reader };
+
+   uint32_t i = first_block_num;
+   while( i <= last_block_num )
+   {
+      replay_item* item = &queue.front();
+      if( item->error )
+         std::rethrow_exception( item->error );
+      if( !item->block )
+      {
+         wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
+         stop_reader();
+         uint32_t dropped_count = 0;
+         while( true )
          {
-            _undo_db.enable();
-            push_block( block, skip );
+            fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+            // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+            // OR
+            // we've caught up to the gap
+            if( !last_id.valid() || block_header::num_from_id( *last_id ) <= i )
+               break;
+            _block_id_to_block.remove( *last_id );
+            ++dropped_count;
          }
-         blocks.pop();
-         ++i;
+         wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
+         break;
       }
+
+      if( !item->precompute_ready() && depth.load() < max_depth )
+      {
+         ++depth;
+         queue.limit_raised();
+      }
+      item->wait_precompute();
+      const signed_block& block = *item->block;
+
+      if( i % 10000 == 0 )
+      {
+         std::stringstream bysize;
+         std::stringstream bynum;
+         size_t current_pos = item->position;
+         if( current_pos > total_block_size )
+            total_block_size = current_pos;
+         bysize << std::fixed << std::setprecision(5) << (100 * double(current_pos) / total_block_size);
+         bynum << std::fixed << std::setprecision(5) << (100 * double(i) / last_block_num);
+         ilog(
+            "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]   "
+            "[look-ahead: ${depth}]",
+            ("size", bysize.str())
+            ("processed", current_pos)
+            ("total", total_block_size)
+            ("num", bynum.str())
+            ("i", i)
+            ("last", last_block_num)
+            ("depth", depth.load())
+         );
+      }
+      if( i == undo_point )
+      {
+         ilog( "Writing object database to disk at block ${i}, please DO NOT kill the program", ("i", i) );
+         flush();
+         ilog( "Done writing object database to disk" );
+      }
+      if( i < undo_point )
+         apply_block( block, item->skip );
+      else
+      {
+         _undo_db.enable();
+         push_block( block, item->skip );
+      }
+      queue.pop();
+      ++i;
    }
    _undo_db.enable();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void database::set_replay_lookahead( uint32_t blocks )
+{
+   _replay_lookahead = std::max<uint32_t>( blocks, 1 );
+}
+
+void database::enable_object_database_checkpoints( uint32_t interval, uint32_t max_segments )
+{
+   FC_ASSERT( !_opened, "Checkpoints must be enabled before the database is opened" );
+   _object_db_checkpoint_interval = ( max_segments > 0 ? interval : 0 );
+   enable_checkpoints( _object_db_checkpoint_interval > 0 ? max_segments : 0 );
+}
+
+void database::checkpoint_irreversible_state()
+{ try {
+   if( _object_db_checkpoint_interval == 0 )
+      return;
+   const uint32_t last_irreversible = get_dynamic_global_properties().last_irreversible_block_num;
+   if( last_irreversible / _object_db_checkpoint_interval
+         <= _object_db_checkpoint_block / _object_db_checkpoint_interval )
+      return;
+   // a reversible block may still be popped, so the checkpoint holds the state as of the last irreversible block,
+   // which is the current state without the changes recorded by the undo states of the blocks after it
+   const uint32_t reversible_blocks = head_block_num() - last_irreversible;
+   if( reversible_blocks > _undo_db.size() )
+   {
+      wlog( "Not enough undo history to checkpoint the state of block ${b}", ("b",last_irreversible) );
+      return;
+   }
+   const auto values_before = _undo_db.get_values_before( reversible_blocks );
+   checkpoint( &values_before );
+   _object_db_checkpoint_block = last_irreversible;
+} FC_CAPTURE_AND_RETHROW() }
+
+void database::set_block_log_layout( uint32_t segment_size, bool compress )
+{
+   FC_ASSERT( !_opened, "The block log layout must be set before the database is opened" );
+   _block_id_to_block.set_layout_for_new_log( segment_size, compress );
+}
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
@@ -178,7 +379,19 @@ void database::open(
           version_file.close();
       }
 
-      object_database::open(data_dir);
+      try
+      {
+         object_database::open(data_dir);
+      }
+      catch( const graphene::db::db_exception& e )
+      {
+         // object_database::open() has dropped whatever it loaded. The objects of one index refer to those of the
+         // others, so a single index cannot be rebuilt on its own, the whole object database is rebuilt from the
+         // block log.
+         elog( "Object database is unusable, rebuilding it from the block log: ${e}", ("e",e.to_detail_string()) );
+         object_database::wipe( data_dir );
+         object_database::open( data_dir );
+      }
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
 
@@ -195,13 +408,34 @@ void database::open(
       }
 
       fc::optional<block_id_type> last_block = _block_id_to_block.last_id();
+
+      // every segment of the block log is a file of its own, warn if the chain is going to need a lot of them
+      const uint32_t segment_size = _block_id_to_block.segment_size();
+      if( segment_size > 0 )
+      {
+         constexpr uint64_t max_recommended_segments = 10000;
+         const uint64_t blocks_per_year = uint64_t( 365 * 24 * 3600 )
+                                          / get_global_properties().parameters.block_interval;
+         const uint64_t chain_length = last_block.valid() ? block_header::num_from_id( *last_block ) : 0;
+         const uint64_t expected_segments = ( chain_length + blocks_per_year ) / segment_size + 1;
+         if( expected_segments > max_recommended_segments )
+            wlog( "The block log segment size of ${s} blocks is going to need ${n} files within a year, "
+                  "please consider a new block log with a larger block-log-segment-size",
+                  ("s",segment_size)("n",expected_segments) );
+      }
       if( last_block.valid() )
       {
          FC_ASSERT( *last_block >= head_block_id(),
                     "last block ID does not match current chain state",
                     ("last_block->id", last_block)("head_block_id",head_block_num()) );
+         // Checkpoints hold irreversible state only, but the block database may still have lost blocks in a crash
+         if( checkpoints_enabled() && head_block_num() > 0 )
+            FC_ASSERT( _block_id_to_block.fetch_block_id( head_block_num() ) == head_block_id(),
+                       "Object database checkpoint is not on the chain of the block database, please replay",
+                       ("head_block_num",head_block_num())("head_block_id",head_block_id()) );
          reindex( data_dir );
       }
+      _object_db_checkpoint_block = get_dynamic_global_properties().last_irreversible_block_num;
       _opened = true;
    }
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
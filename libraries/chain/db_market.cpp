@@ -54,23 +54,15 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
     if( !call_ptr ) // no call order
        return false;
 
-    const limit_order_index& limit_index = get_index_type<limit_order_index>();
-    const auto& limit_price_index = limit_index.indices().get<by_price>();
-
-    // looking for limit orders selling the most USD for the least CORE
-    auto highest_possible_bid = price::max( debt_asset_id, bitasset.options.short_backing_asset );
-    // stop when limit orders are selling too little USD for too much CORE
-    auto lowest_possible_bid  = price::min( debt_asset_id, bitasset.options.short_backing_asset );
-
-    FC_ASSERT( highest_possible_bid.base.asset_id == lowest_possible_bid.base.asset_id );
-    // NOTE limit_price_index is sorted from greatest to least
-    auto limit_itr = limit_price_index.lower_bound( highest_possible_bid );
-    auto limit_end = limit_price_index.upper_bound( lowest_possible_bid );
+    // looking for the limit order selling the most USD for the least CORE
+    const limit_order_object* best_bid = get_index_type< primary_index< limit_order_index > >()
+                                            .get_secondary_index< limit_order_book_index >()
+                                            .best_order( debt_asset_id, bitasset.options.short_backing_asset );
 
     price call_pays_price;
-    if( limit_itr != limit_end )
+    if( best_bid )
     {
-       call_pays_price = limit_itr->sell_price;
+       call_pays_price = best_bid->sell_price;
        if( after_core_hardfork_2481 )
        {
           // due to margin call fee, we check with MCPP (margin call pays price) here
@@ -99,9 +91,9 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
           highest = bitasset.current_feed.max_short_squeeze_price_before_hf_1270();
        // else do nothing
 
-       if( limit_itr != limit_end )
+       if( best_bid )
        {
-          FC_ASSERT( highest.base.asset_id == limit_itr->sell_price.base.asset_id );
+          FC_ASSERT( highest.base.asset_id == best_bid->sell_price.base.asset_id );
           if( bsrm_type::individual_settlement_to_fund != bsrm )
              highest = std::max( call_pays_price, highest );
           // for individual_settlement_to_fund, if call_pays_price < current_feed.max_short_squeeze_price(),
@@ -143,7 +135,7 @@ bool database::check_for_blackswan( const asset_object& mia, bool enable_black_s
              "   Max:                       ${~h}  ${h}\n",
             ("id",mia.id)("symbol",mia.symbol)("b",head_block_num())
             ("lc",least_collateral.to_real())("~lc",(~least_collateral).to_real())
-          //  ("hb",limit_itr->sell_price.to_real())("~hb",(~limit_itr->sell_price).to_real())
+          //  ("hb",best_bid->sell_price.to_real())("~hb",(~best_bid->sell_price).to_real())
             ("sp",settle_price.to_real())("~sp",(~settle_price).to_real())
             ("h",highest.to_real())("~h",(~highest).to_real()) );
        edump((enable_black_swan));
@@ -722,18 +714,16 @@ bool database::apply_order(const limit_order_object& new_order_object)
    asset_id_type recv_asset_id = new_order_object.receive_asset_id();
 
    // We only need to check if the new order will match with others if it is at the front of the book
-   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
-   auto limit_itr = limit_price_idx.iterator_to( new_order_object );
-   if( limit_itr != limit_price_idx.begin() )
-   {
-      --limit_itr;
-      if( limit_itr->sell_asset_id() == sell_asset_id && limit_itr->receive_asset_id() == recv_asset_id )
-         return false;
-   }
+   const auto& order_book = get_index_type< primary_index< limit_order_index > >()
+                               .get_secondary_index< limit_order_book_index >();
+   if( order_book.best_order( sell_asset_id, recv_asset_id ) != &new_order_object )
+      return false;
 
-   // this is the opposite side (on the book)
+   // this is the opposite side (on the book).
+   // Note: matching walks the by_price index, whose iterators stay valid while the orders are filled
+   const auto& limit_price_idx = get_index_type<limit_order_index>().indices().get<by_price>();
    auto max_price = ~new_order_object.sell_price;
-   limit_itr = limit_price_idx.lower_bound( max_price.max() );
+   auto limit_itr = limit_price_idx.lower_bound( max_price.max() );
    auto limit_end = limit_price_idx.upper_bound( max_price );
 
    // Order matching should be in favor of the taker.
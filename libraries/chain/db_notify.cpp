@@ -685,7 +685,7 @@ void database::notify_changed_objects()
         for( const auto& item : head_undo.old_values )
         {
           changed_ids.push_back(item.first);
-          get_relevant_accounts(item.second.get(), changed_accounts_impacted,
+          get_relevant_accounts(item.second, changed_accounts_impacted,
                                 MUST_IGNORE_CUSTOM_OP_REQD_AUTHS(chain_time));
         }
 
@@ -704,7 +704,7 @@ void database::notify_changed_objects()
         for( const auto& item : head_undo.removed )
         {
           removed_ids.emplace_back( item.first );
-          auto* obj = item.second.get();
+          const auto* obj = item.second;
           removed.emplace_back( obj );
           get_relevant_accounts(obj, removed_accounts_impacted,
                                 MUST_IGNORE_CUSTOM_OP_REQD_AUTHS(chain_time));
@@ -124,17 +124,21 @@ void database::clear_expired_transactions()
    //Transactions must have expired by at least two forking windows in order to be removed.
    auto& transaction_idx = static_cast<transaction_index&>(get_mutable_index(implementation_ids,
                                                                              impl_transaction_history_object_type));
-   const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
-   while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.begin()->trx.expiration) )
-      transaction_idx.remove(*dedupe_index.begin());
+   const auto& expiring = get_index_type< primary_index< transaction_index > >()
+                             .get_secondary_index< transaction_expiration_index >();
+   // expired strictly before the head block time
+   const fc::time_point_sec deadline( head_block_time().sec_since_epoch() - 1 );
+   while( const transaction_history_object* trx = expiring.next_expired( deadline ) )
+      transaction_idx.remove( *trx );
 } FC_CAPTURE_AND_RETHROW() } // GCOVR_EXCL_LINE
 
 void database::clear_expired_proposals()
 {
-   const auto& proposal_expiration_index = get_index_type<proposal_index>().indices().get<by_expiration>();
-   while( !proposal_expiration_index.empty() && proposal_expiration_index.begin()->expiration_time <= head_block_time() )
+   const auto& expiring = get_index_type< primary_index< proposal_index > >()
+                             .get_secondary_index< proposal_expiration_index >();
+   while( const proposal_object* proposal_ptr = expiring.next_expired( head_block_time() ) )
    {
-      const proposal_object& proposal = *proposal_expiration_index.begin();
+      const proposal_object& proposal = *proposal_ptr;
       processed_transaction result;
       try {
          if( proposal.is_authorized_to_execute(*this) )
@@ -302,10 +306,11 @@ void database::clear_expired_orders()
 
          bool before_core_hardfork_606 = ( maint_time <= HARDFORK_CORE_606_TIME ); // feed always trigger call
 
-         auto& limit_index = get_index_type<limit_order_index>().indices().get<by_expiration>();
-         while( !limit_index.empty() && limit_index.begin()->expiration <= head_time )
+         const auto& expiring = get_index_type< primary_index< limit_order_index > >()
+                                   .get_secondary_index< limit_order_expiration_index >();
+         while( const limit_order_object* order_ptr = expiring.next_expired( head_time ) )
          {
-            const limit_order_object& order = *limit_index.begin();
+            const limit_order_object& order = *order_ptr;
             auto base_asset = order.sell_price.base.asset_id;
             auto quote_asset = order.sell_price.quote.asset_id;
             cancel_limit_order( order );
@@ -604,18 +609,19 @@ void database::update_maintenance_flag( bool new_maintenance_flag )
 
 void database::update_withdraw_permissions()
 {
-   auto& permit_index = get_index_type<withdraw_permission_index>().indices().get<by_expiration>();
-   while( !permit_index.empty() && permit_index.begin()->expiration <= head_block_time() )
-      remove(*permit_index.begin());
+   const auto& expiring = get_index_type< primary_index< withdraw_permission_index > >()
+                             .get_secondary_index< withdraw_permission_expiration_index >();
+   while( const withdraw_permission_object* permit = expiring.next_expired( head_block_time() ) )
+      remove( *permit );
 }
 
 void database::clear_expired_htlcs()
 {
-   const auto& htlc_idx = get_index_type<htlc_index>().indices().get<by_expiration>();
-   while ( htlc_idx.begin() != htlc_idx.end()
-         && htlc_idx.begin()->conditions.time_lock.expiration <= head_block_time() )
+   const auto& expiring = get_index_type< primary_index< htlc_index > >()
+                             .get_secondary_index< htlc_expiration_index >();
+   while( const htlc_object* htlc_ptr = expiring.next_expired( head_block_time() ) )
    {
-      const htlc_object& obj = *htlc_idx.begin();
+      const htlc_object& obj = *htlc_ptr;
       const auto amount = asset(obj.transfer.amount, obj.transfer.asset_id);
       adjust_balance( obj.transfer.from, amount );
       // notify related parties
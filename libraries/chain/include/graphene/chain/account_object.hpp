@@ -3,9 +3,14 @@
 
 #include <graphene/chain/types.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/dense_generic_index.hpp>
 #include <graphene/protocol/account.hpp>
+#include <graphene/protocol/transaction.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <mutex>
 
 namespace graphene { namespace chain {
    class database;
@@ -332,6 +337,57 @@ namespace graphene { namespace chain {
    };
 
 
+   /**
+    *  @brief Remembers the signing keys that satisfied the authorities of accounts, see @ref authority_check_cache
+    *
+    *  As a secondary index of the accounts it counts the changes of the owner and active authority of each account,
+    *  and an outcome is reused for as long as none of the authorities read to reach it changed.  Only the outcomes
+    *  used most recently are kept.  It is also used by API calls, so it is thread safe.
+    */
+   class account_authority_cache : public secondary_index, public authority_check_cache
+   {
+      public:
+         explicit account_authority_cache( size_t capacity = 10000 ) : _capacity( capacity ) {}
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         virtual bool satisfied( const authority_check_key& key ) override;
+         virtual void add( authority_check_key&& key, const flat_set<account_id_type>& accounts_read ) override;
+
+         /// Keep at most @p capacity outcomes, 0 to keep none
+         void set_capacity( size_t capacity );
+         size_t size()const;
+
+      private:
+         struct entry
+         {
+            authority_check_key key;
+            /// Accounts whose authorities were read, with the number of changes of their authorities back then
+            vector< std::pair< account_id_type, uint32_t > > accounts_read;
+         };
+         struct by_key;
+         typedef multi_index_container<
+            entry,
+            indexed_by<
+               sequenced<>, // most recently used first
+               ordered_unique< tag<by_key>, member< entry, authority_check_key, &entry::key > >
+            >
+         > entry_index;
+
+         uint32_t version( const account_id_type& account )const;
+         void changed( const account_id_type& account );
+
+         mutable std::mutex                             _mutex;
+         entry_index                                    _entries;
+         size_t                                         _capacity;
+         /** Number of changes of the authorities of each account, by instance */
+         vector< uint32_t >                             _versions;
+         std::stack< std::pair< authority, authority > > _authorities_being_modified;
+   };
+
    /**
     *  @brief This secondary index will allow fast access to the balance objects
     *         that belonging to an account.
@@ -388,7 +444,7 @@ namespace graphene { namespace chain {
    /**
     * @ingroup object_index
     */
-   typedef generic_index<account_balance_object, account_balance_object_multi_index_type> account_balance_index;
+   typedef dense_generic_index<account_balance_object, account_balance_object_multi_index_type> account_balance_index;
 
    struct by_name;
 
@@ -7,13 +7,46 @@
 
 #include <fc/filesystem.hpp>
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 namespace graphene { namespace chain {
    struct index_entry;
    using namespace graphene::protocol;
 
+   /**
+    *  Stores the blocks in one or more files, with a second file of fixed-size entries indexed by block number.
+    *
+    *  A new block log can be split into segment files of a fixed number of blocks, and the blocks can be
+    *  compressed individually with zlib using a dictionary built from the first blocks of the chain, see
+    *  set_layout_for_new_log().  Either way a block is found with a single index lookup.
+    *
+    *  The methods which modify the files, and open(), close(), last(), last_id() and total_block_size(), must be
+    *  called from a single thread.  contains(), fetch_block_id(), fetch_optional() and fetch_by_number() read
+    *  through memory mappings of the files, so that e.g. the replay can read ahead on a thread of its own.
+    *  database::fetch_block_by_id() and fetch_block_by_number() consult the fork database first, which is not
+    *  synchronized, so they must still be called from the thread that applies the blocks.
+    */
    class block_database 
    {
       public:
+         block_database();
+         ~block_database();
+
+         /**
+          *  Sets the layout used if open() creates a new block log, an existing log keeps its layout.
+          *  @param segment_size number of blocks per file, 0 for a single file
+          *  @param compress whether to compress the blocks
+          */
+         void set_layout_for_new_log( uint32_t segment_size, bool compress );
+         /// @return number of blocks per file of the open block log, 0 if all blocks are stored in one file
+         uint32_t segment_size()const { return _segment_size; }
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
@@ -28,12 +61,58 @@ namespace graphene { namespace chain {
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
-         size_t                 blocks_current_position()const;
+         /// @return the end of block @p block_num in the concatenation of all segments, 0 if it is not stored,
+         ///         for progress reports against total_block_size()
+         size_t                 block_end_position( uint32_t block_num )const;
          size_t                 total_block_size()const;
       private:
+         struct mapped_file;
+         using mapped_file_ptr = std::shared_ptr<const mapped_file>;
+
          optional<index_entry> last_index_entry()const;
+
+         /// @return a mapping of the file covering at least @p needed bytes, nullptr if the file is smaller.  The
+         ///         mapping extends beyond the end of the file, so that it can be reused while the file grows.
+         mapped_file_ptr map( mapped_file_ptr& current, const fc::path& file,
+                              const std::function<uint64_t()>& available, uint64_t needed )const;
+         optional<index_entry>  read_index_entry( uint32_t block_num )const;
+         optional<signed_block> read_block( const index_entry& e )const;
+         /// @return the mapping slot of @p segment, added if the log has grown by more segments
+         mapped_file_ptr&       segment_map( uint32_t segment )const;
+         void                   clear_segment_maps();
+         /// Makes the data written so far readable through the mappings
+         void                   flush_files();
+
+         fc::path  segment_filename( uint32_t segment )const;
+         uint32_t  segment_of( uint32_t block_num )const;
+         /// Points _blocks to the file of @p segment
+         void      open_segment( uint32_t segment );
+         void      train_dictionary();
+
+         fc::path _dir;
          fc::path _index_filename;
          mutable std::fstream _blocks;
          mutable std::fstream _block_num_to_pos;
+         uint32_t             _blocks_segment = 0;
+
+         uint32_t _new_segment_size = 0;
+         bool     _new_compress = false;
+         uint32_t _segment_size = 0;   ///< 0 if all blocks are stored in one file
+         bool     _compress = false;
+         /// Dictionary of the compressed blocks, accessed with std::atomic_load and std::atomic_store
+         std::shared_ptr<const std::string> _dictionary;
+
+         /// Read-only mappings, replaced by larger ones when the files grow.  Accessed with std::atomic_load and
+         /// std::atomic_store, readers keep using the mapping they loaded until they are done.
+         mutable mapped_file_ptr                    _index_map;
+         /// One slot per segment, only ever appended to while the log is open so that the slots stay in place.
+         /// The container itself is guarded by _remap_mutex.
+         mutable std::deque<mapped_file_ptr>        _segment_maps;
+         mutable std::mutex                         _remap_mutex;
+         /// Number of bytes of the index file which have been flushed and may be read through the mapping,
+         /// maintained by the writer so that storing a block does not need to ask the file system
+         mutable std::atomic<uint64_t>              _index_size{0};
+         /// Start of each segment in the concatenation of all segments, see total_block_size()
+         mutable std::vector<uint64_t>              _segment_offsets;
    };
 } }
@@ -20,9 +20,9 @@ namespace graphene { namespace chain {
    class custom_authority_object : public abstract_object<custom_authority_object,
                                              protocol_ids, custom_authority_object_type>
    {
-      /// Unreflected field to store a cache of the predicate function
-      /// Note that this cache can be modified when the object is const!
-      mutable optional<restriction_predicate_function> predicate_cache;
+      /// Unreflected field to store a cache of the predicate function, shared with the objects having the same
+      /// restrictions.  Note that this cache can be modified when the object is const!
+      mutable shared_restriction_predicate predicate_cache;
 
    public:
       account_id_type account;
@@ -45,15 +45,15 @@ namespace graphene { namespace chain {
          return rs;
       }
       /// Get predicate, from cache if possible, and update cache if not (modifies const object!)
-      restriction_predicate_function get_predicate() const {
-         if (!predicate_cache.valid())
+      const restriction_predicate_function& get_predicate() const {
+         if (!predicate_cache)
             update_predicate_cache();
 
          return *predicate_cache;
       }
       /// Regenerate predicate function and update predicate cache
       void update_predicate_cache() const {
-         predicate_cache = get_restriction_predicate(get_restrictions(), operation_type);
+         predicate_cache = get_shared_restriction_predicate(get_restrictions(), operation_type);
       }
       /// Clear the cache of the predicate function
       void clear_predicate_cache() { predicate_cache.reset(); }
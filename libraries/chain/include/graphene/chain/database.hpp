@@ -13,6 +13,8 @@
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/transaction_pool.hpp>
+#include <graphene/chain/vote_tally_cache.hpp>
 #include <graphene/chain/evaluator.hpp>
 
 #include <graphene/db/object_database.hpp>
@@ -553,9 +555,23 @@ namespace graphene { namespace chain {
          bool before_last_checkpoint()const;
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
+         /**
+          *  Applies @p trx to the pending state and adds it to the pending transactions.  A transaction that is
+          *  pending already is rejected with duplicate_transaction even if @p skip contains
+          *  skip_transaction_dupe_check, which only skips the check against the transactions in blocks.
+          */
          processed_transaction push_transaction( const precomputable_transaction& trx, uint32_t skip = skip_nothing );
+         /**
+          *  Pushes the transactions one after the other, like push_transaction() but in one go.  Nothing else runs on
+          *  this thread meanwhile, so callers keep @p trxs short
+          *  @return for each transaction, the exception that kept it from being pushed, if any
+          */
+         vector<fc::oexception> push_transactions( const vector<precomputable_transaction>& trxs,
+                                                   uint32_t skip = skip_nothing );
       private:
          bool _push_block( const signed_block& b );
+         /// Checks the limits push_transaction() puts on a transaction before applying it
+         void check_transaction_to_push( const precomputable_transaction& trx )const;
       public:
          // It is public because it is used in pending_transactions_restorer in db_with.hpp
          processed_transaction _push_transaction( const precomputable_transaction& trx );
@@ -663,10 +679,22 @@ namespace graphene { namespace chain {
           *         precomputations applied
           */
          fc::future<void> precompute_parallel( const precomputable_transaction& trx )const;
+
+         /** Precomputes digests, signatures and operation validations of many transactions in parallel.
+          *  Transactions that fail to validate are left to push_transactions() to report.
+          *
+          * @param trxs the transactions to preprocess
+          * @return a future that will resolve when the transactions are preprocessed
+          */
+         fc::future<void> precompute_parallel( const vector<precomputable_transaction>& trxs )const;
       private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
 
+         /// Starts the precomputations of precompute_parallel( block, skip ) without waiting for any of them
+         /// @return the futures of the parallel precomputations, all of them refer to @p block
+         std::vector<fc::future<void>> start_precompute( const signed_block& block, const uint32_t skip )const;
+
       protected:
          // Mark pop_undo() as protected -- we do not want outside calling pop_undo(),
          // it should call pop_block() instead
@@ -676,6 +704,9 @@ namespace graphene { namespace chain {
          optional<undo_database::session>       _pending_tx_session;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
 
+         /// Checkpoints the object database as of the last irreversible block whenever that crosses the interval
+         void checkpoint_irreversible_state();
+
          template<class Index>
          vector<std::reference_wrapper<const typename Index::object_type>> sort_votable_objects(size_t count)const;
 
@@ -754,7 +785,13 @@ namespace graphene { namespace chain {
          ///@}
          ///@}
 
-         vector< processed_transaction >        _pending_tx;
+         /// @return the priority of @p pending in the transaction pool
+         uint64_t pending_fee_per_kbyte( const pending_transaction& pending )const;
+
+         transaction_pool                       _pending_tx;
+         /// Maximum number of pending transactions per fee paying account accepted by push_transaction(), 0 for
+         /// no limit
+         uint32_t                               _max_pending_tx_per_account = 0;
          fork_database                          _fork_db;
 
          /**
@@ -785,10 +822,16 @@ namespace graphene { namespace chain {
          uint32_t                          _current_virtual_op   = 0;
 
          vector<uint64_t>                  _vote_tally_buffer;
+         /// Instances of the vote IDs with votes in _vote_tally_buffer, in the order they got their first vote
+         vector<uint32_t>                  _voted_vote_ids;
          vector<uint64_t>                  _witness_count_histogram_buffer;
          vector<uint64_t>                  _committee_count_histogram_buffer;
          std::array<uint64_t,2>            _total_voting_stake; // 0=committee, 1=witness,
                                                                 // as in vote_id_type::vote_type
+         /// What the accounts added to the last vote tally
+         vote_tally_cache                  _vote_tally_cache;
+         /// Outcomes of authority verifications, a secondary index of the accounts
+         account_authority_cache*          _authority_cache = nullptr;
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
@@ -798,6 +841,13 @@ namespace graphene { namespace chain {
          /// Set it to true to provide accurate data to API clients, set to false to have better performance.
          bool                              _track_standby_votes = true;
 
+         /// Write an incremental object database checkpoint every this many irreversible blocks, 0 to disable
+         uint32_t                          _object_db_checkpoint_interval = 0;
+         /// Last irreversible block as of the last object database checkpoint
+         uint32_t                          _object_db_checkpoint_block = 0;
+         /// Maximum number of blocks the replay reads and precomputes ahead of the block being applied
+         uint32_t                          _replay_lookahead = 200;
+
          /**
           * Whether database is successfully opened or not.
           *
@@ -825,6 +875,26 @@ namespace graphene { namespace chain {
       public:
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
+         /**
+          * Save the changed objects to disk every @p interval irreversible blocks, so that after an unclean shutdown
+          * the node resumes from the last checkpoint instead of replaying.  Must be called before open().
+          * @param interval number of irreversible blocks between checkpoints, 0 to disable
+          * @param max_segments number of incremental checkpoints before a full flush of the object database
+          */
+         void enable_object_database_checkpoints( uint32_t interval, uint32_t max_segments );
+         /**
+          * Layout of the block log if open() has to create a new one, see block_database::set_layout_for_new_log().
+          * Must be called before open().
+          */
+         void set_block_log_layout( uint32_t segment_size, bool compress );
+         /// Maximum number of blocks reindex() reads and precomputes ahead of the block being applied
+         void set_replay_lookahead( uint32_t blocks );
+         /// Limit the number of pending transactions per fee paying account, 0 for no limit
+         void set_max_pending_transactions_per_account( uint32_t limit ) { _max_pending_tx_per_account = limit; }
+         /// Outcomes of authority verifications to reuse when verifying transactions, also for API calls
+         account_authority_cache* get_authority_cache()const { return _authority_cache; }
+         /// Recount the votes of all accounts every @p interval maintenance intervals, 0 or 1 to always recount
+         void set_vote_tally_recount_interval( uint32_t interval ) { _vote_tally_cache.set_check_interval( interval ); }
    };
 
 } }
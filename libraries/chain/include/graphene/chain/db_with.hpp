@@ -49,9 +49,10 @@ struct skip_flags_restorer
  */
 struct pending_transactions_restorer
 {
-   pending_transactions_restorer( database& db, std::vector<processed_transaction>&& pending_transactions )
-      : _db(db), _pending_transactions( std::move(pending_transactions) )
+   pending_transactions_restorer( database& db, transaction_pool&& pending_transactions )
+      : _db(db)
    {
+      _pending_transactions.swap( pending_transactions );
       _db.clear_pending();
    }
 
@@ -67,12 +68,14 @@ struct pending_transactions_restorer
          }
       }
       _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
+      // these would fail to apply on top of the new head block
+      _pending_transactions.remove_expired( _db.head_block_time() );
+      for( const pending_transaction& pending : _pending_transactions.get<transaction_pool::by_sequence>() )
       {
          try
          {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
+            if( !_db.is_known_transaction( pending.id ) ) {
+               _db._push_transaction( pending.trx );
             }
          }
          catch( const fc::exception& )
@@ -82,7 +85,7 @@ struct pending_transactions_restorer
    }
 
    database& _db;
-   std::vector< processed_transaction > _pending_transactions;
+   transaction_pool _pending_transactions;
 };
 
 /**
@@ -112,7 +115,7 @@ void with_skip_flags(
 template< typename Lambda >
 void without_pending_transactions(
    database& db,
-   std::vector<processed_transaction>&& pending_transactions,
+   transaction_pool&& pending_transactions,
    Lambda callback )
 {
     pending_transactions_restorer restorer( db, std::move(pending_transactions) );
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <graphene/protocol/htlc.hpp>
+#include <graphene/db/expiration_wheel.hpp>
 #include <graphene/db/generic_index.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
@@ -73,16 +74,11 @@ namespace graphene { namespace chain {
    };
 
    struct by_from_id;
-   struct by_expiration;
    struct by_to_id;
    using htlc_object_multi_index_type = multi_index_container<
          htlc_object,
          indexed_by<
             ordered_unique< tag< by_id >, member< object, object_id_type, &object::id > >,
-            ordered_unique< tag< by_expiration >,
-               composite_key< htlc_object,
-                  htlc_object::timelock_extractor,
-                  member< object, object_id_type, &object::id > > >,
             ordered_unique< tag< by_from_id >,
                composite_key< htlc_object,
                   htlc_object::from_extractor,
@@ -96,6 +92,9 @@ namespace graphene { namespace chain {
 
    using htlc_index = generic_index< htlc_object, htlc_object_multi_index_type >;
 
+   /// HTLCs in the order their time locks expire
+   using htlc_expiration_index = expiration_wheel< htlc_object, htlc_object::timelock_extractor >;
+
 } } // namespace graphene::chain
 
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::htlc_object)
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <graphene/chain/types.hpp>
+#include <graphene/db/expiration_wheel.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <graphene/protocol/asset.hpp>
 #include <graphene/protocol/market.hpp>
@@ -61,7 +62,6 @@ class limit_order_object : public abstract_object<limit_order_object, protocol_i
 };
 
 struct by_price;
-struct by_expiration;
 struct by_account;
 struct by_account_price;
 struct by_is_settled_debt;
@@ -69,12 +69,6 @@ typedef multi_index_container<
    limit_order_object,
    indexed_by<
       ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
-      ordered_unique< tag<by_expiration>,
-         composite_key< limit_order_object,
-            member< limit_order_object, time_point_sec, &limit_order_object::expiration>,
-            member< object, object_id_type, &object::id>
-         >
-      >,
       ordered_unique< tag<by_price>,
          composite_key< limit_order_object,
             member< limit_order_object, price, &limit_order_object::sell_price>,
@@ -110,6 +104,50 @@ typedef multi_index_container<
 
 typedef generic_index<limit_order_object, limit_order_multi_index_type> limit_order_index;
 
+/// Limit orders in the order they expire
+typedef expiration_wheel< limit_order_object,
+                          member< limit_order_object, time_point_sec, &limit_order_object::expiration > >
+        limit_order_expiration_index;
+
+/**
+ *  @brief Aggregates the limit orders of each side of each market into price levels
+ *
+ *  A side is identified by the asset sold and the asset received.  Its levels are sorted best price first and
+ *  the orders of a level by ID, i.e. in the order of the @ref by_price index, so that walking a side yields its
+ *  orders in matching order without touching any other market, and the best order of a side is found in O(1).
+ */
+class limit_order_book_index : public secondary_index
+{
+   public:
+      struct price_level
+      {
+         /// Sum of the amounts for sale of the orders, in the asset sold
+         share_type total_for_sale;
+         /// Node based, orders are filled and cancelled from anywhere in large levels
+         std::map< limit_order_id_type, const limit_order_object* > orders;
+      };
+      /// Levels keyed by price, orders with prices of the same ratio share a level
+      typedef std::map< price, price_level, std::greater<price> > book_side;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /// @return the levels of orders selling @p sell for @p receive, nullptr if there is none
+      const book_side* find_side( const asset_id_type& sell, const asset_id_type& receive )const;
+      /// @return the order that matches first among those selling @p sell for @p receive, nullptr if there is none
+      const limit_order_object* best_order( const asset_id_type& sell, const asset_id_type& receive )const;
+
+   private:
+      void add( const limit_order_object& order );
+      void remove( const limit_order_id_type& id, const price& sell_price, const share_type& for_sale );
+
+      map< std::pair< asset_id_type, asset_id_type >, book_side > sides;
+      /** Price and amount for sale of the orders being modified, as they are filed */
+      std::stack< std::tuple< limit_order_id_type, price, share_type > > orders_being_modified;
+};
+
 /**
  * @class call_order_object
  * @brief tracks debt and call price information
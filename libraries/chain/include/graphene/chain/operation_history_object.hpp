@@ -5,6 +5,7 @@
 
 #include <graphene/protocol/operations.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/generic_index.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
 
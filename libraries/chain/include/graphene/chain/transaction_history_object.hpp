@@ -2,6 +2,7 @@
 #pragma once
 
 #include <graphene/protocol/transaction.hpp>
+#include <graphene/db/expiration_wheel.hpp>
 #include <graphene/db/generic_index.hpp>
 
 #include <boost/multi_index_container.hpp>
@@ -29,20 +30,23 @@ namespace graphene { namespace chain {
          time_point_sec get_expiration()const { return trx.expiration; }
    };
 
-   struct by_expiration;
    struct by_trx_id;
    typedef multi_index_container<
       transaction_history_object,
       indexed_by<
          ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_history_object, transaction_id_type, trx_id),
-                        std::hash<transaction_id_type> >,
-         ordered_non_unique< tag<by_expiration>, const_mem_fun< transaction_history_object, time_point_sec,
-                                                                &transaction_history_object::get_expiration > >
+                        std::hash<transaction_id_type> >
       >
    > transaction_multi_index_type;
 
    typedef generic_index<transaction_history_object, transaction_multi_index_type> transaction_index;
+
+   /// Transactions in the order they expire
+   typedef expiration_wheel< transaction_history_object,
+                             const_mem_fun< transaction_history_object, time_point_sec,
+                                            &transaction_history_object::get_expiration > >
+           transaction_expiration_index;
 } }
 
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::transaction_history_object)
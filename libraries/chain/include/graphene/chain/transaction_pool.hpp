@@ -0,0 +1,116 @@
+/*
+ * Acloudbank
+ */
+#pragma once
+
+#include <graphene/protocol/transaction.hpp>
+
+#include <graphene/chain/types.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+namespace graphene { namespace chain {
+   using boost::multi_index_container;
+   using namespace boost::multi_index;
+
+   /**
+    *  A transaction that has been applied to the pending state, with what the block producer needs to know about
+    *  it without applying it again.
+    */
+   struct pending_transaction
+   {
+      explicit pending_transaction( const processed_transaction& t );
+
+      processed_transaction trx;
+      /// Position in arrival order, which is the order of the pending state
+      uint64_t              sequence = 0;
+      transaction_id_type   id;
+      fc::time_point_sec    expiration;
+      /// Pays the fee of the first operation, the pool limits the pending transactions per fee payer
+      account_id_type       fee_payer;
+      /// Packed size in a block, i.e. without operation results
+      uint64_t              packed_size = 0;
+      /// Fees of all operations, in the core asset, per 1024 bytes of packed size
+      uint64_t              fee_per_kbyte = 0;
+      /// Skip flags it was applied with
+      uint32_t              skip = 0;
+   };
+
+   /// @return the account paying the fee of the first operation of @p trx, the default account if there is none
+   account_id_type pending_fee_payer( const transaction& trx );
+
+   /// @return the fees of the operations of @p trx
+   vector<asset> operation_fees( const transaction& trx );
+
+   /**
+    *  The transactions that have been applied to the pending state but are not in a block yet.
+    *
+    *  Iterating by_sequence yields the order they have been applied in, by_priority the order a block producer
+    *  prefers them in: highest fee per byte first, then first come first served.  Each transaction ID is pending
+    *  at most once, database::push_transaction() rejects a pending transaction before applying it again.
+    */
+   class transaction_pool
+   {
+      public:
+         struct by_sequence;
+         struct by_id;
+         struct by_expiration;
+         struct by_priority;
+         struct by_fee_payer;
+         typedef multi_index_container<
+            pending_transaction,
+            indexed_by<
+               ordered_unique< tag<by_sequence>,
+                  member< pending_transaction, uint64_t, &pending_transaction::sequence > >,
+               hashed_unique< tag<by_id>,
+                  member< pending_transaction, transaction_id_type, &pending_transaction::id >,
+                  std::hash<transaction_id_type> >,
+               ordered_non_unique< tag<by_expiration>,
+                  member< pending_transaction, fc::time_point_sec, &pending_transaction::expiration > >,
+               ordered_unique< tag<by_priority>,
+                  composite_key< pending_transaction,
+                     member< pending_transaction, uint64_t, &pending_transaction::fee_per_kbyte >,
+                     member< pending_transaction, uint64_t, &pending_transaction::sequence >
+                  >,
+                  composite_key_compare< std::greater<uint64_t>, std::less<uint64_t> >
+               >,
+               ordered_unique< tag<by_fee_payer>,
+                  composite_key< pending_transaction,
+                     member< pending_transaction, account_id_type, &pending_transaction::fee_payer >,
+                     member< pending_transaction, uint64_t, &pending_transaction::sequence >
+                  >
+               >
+            >
+         > index_type;
+
+         /// Appends @p trx in arrival order, @p trx must not be pending already
+         const pending_transaction& insert( pending_transaction&& trx );
+
+         bool   contains( const transaction_id_type& id )const;
+         size_t count_by_fee_payer( const account_id_type& account )const;
+
+         /**
+          *  Removes the transactions that expire before @p now, in O(log n) per removed transaction.  Only valid
+          *  while the pending state is not applied, as it contains their changes.
+          *  @return the number of removed transactions
+          */
+         size_t remove_expired( fc::time_point_sec now );
+
+         size_t size()const  { return _index.size(); }
+         bool   empty()const { return _index.empty(); }
+         void   clear()      { _index.clear(); }
+         void   swap( transaction_pool& other );
+
+         template<typename Tag>
+         const typename index_type::template index<Tag>::type& get()const { return _index.template get<Tag>(); }
+
+      private:
+         index_type _index;
+         uint64_t   _next_sequence = 0;
+   };
+
+} } // graphene::chain
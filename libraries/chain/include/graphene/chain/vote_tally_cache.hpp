@@ -0,0 +1,210 @@
+/*
+ * Acloudbank
+ */
+#pragma once
+
+#include <graphene/chain/account_object.hpp>
+
+#include <array>
+#include <atomic>
+#include <stack>
+#include <tuple>
+
+namespace graphene { namespace chain {
+
+   /// What a voting account adds to the vote tally
+   struct vote_tally_entry
+   {
+      const account_object* opinion_account = nullptr;
+      const account_statistics_object* opinion_account_stats = nullptr;
+      std::array<uint64_t,3> voting_stake = {}; // 0=committee, 1=witness, 2=worker, as in vote_id_type::vote_type
+      uint64_t num_committee_voting_stake = 0;
+      uint64_t vp_all = 0;
+      uint64_t vp_active = 0;
+      uint64_t vp_committee = 0;
+      uint64_t vp_witness = 0;
+      uint64_t vp_worker = 0;
+
+      friend bool operator == ( const vote_tally_entry& a, const vote_tally_entry& b )
+      {
+         return std::tie( a.opinion_account, a.opinion_account_stats, a.voting_stake, a.num_committee_voting_stake,
+                          a.vp_all, a.vp_active, a.vp_committee, a.vp_witness, a.vp_worker )
+             == std::tie( b.opinion_account, b.opinion_account_stats, b.voting_stake, b.num_committee_voting_stake,
+                          b.vp_all, b.vp_active, b.vp_committee, b.vp_witness, b.vp_worker );
+      }
+   };
+
+   /**
+    *  @brief Counts the changes of the fields that go into the vote tally, per account
+    *
+    *  @tparam Fields provides key(), the instance of the account an object belongs to, and values(), a tuple of the
+    *          fields of the object that go into the vote tally
+    */
+   template< typename Object, typename Fields >
+   class vote_change_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override
+         {
+            changed( static_cast<const Object&>( obj ) );
+         }
+
+         virtual void object_removed( const object& obj ) override
+         {
+            changed( static_cast<const Object&>( obj ) );
+         }
+
+         virtual void about_to_modify( const object& before ) override
+         {
+            being_modified.push( Fields::values( static_cast<const Object&>( before ) ) );
+         }
+
+         virtual void object_modified( const object& after  ) override
+         {
+            const Object& o = static_cast<const Object&>( after );
+            if( being_modified.top() != Fields::values( o ) )
+               changed( o );
+            being_modified.pop();
+         }
+
+         /// @return a number that changes whenever the fields of the account with @p instance change
+         uint32_t version( uint64_t instance )const
+         {
+            return instance < versions.size() ? versions[instance] : 0;
+         }
+
+      private:
+         void changed( const Object& o )
+         {
+            const uint64_t instance = Fields::key( o );
+            if( instance >= versions.size() )
+               versions.resize( instance + 1, 0 );
+            ++versions[instance];
+         }
+
+         vector<uint32_t> versions;
+         std::stack< typename Fields::values_type > being_modified;
+   };
+
+   struct account_vote_fields
+   {
+      typedef std::tuple< account_statistics_id_type, account_id_type, flat_set<vote_id_type>, uint16_t, uint16_t,
+                          uint16_t, time_point_sec, optional<vesting_balance_id_type> > values_type;
+
+      static uint64_t key( const account_object& a ) { return a.id.instance(); }
+      static values_type values( const account_object& a )
+      {
+         return std::make_tuple( a.statistics, a.options.voting_account, a.options.votes, a.options.num_witness,
+                                 a.options.num_committee, a.num_committee_voted, a.membership_expiration_date,
+                                 a.cashback_vb );
+      }
+   };
+
+   struct account_statistics_vote_fields
+   {
+      typedef std::tuple< share_type, share_type, share_type, share_type, share_type, share_type, share_type,
+                          time_point_sec, bool, bool > values_type;
+
+      static uint64_t key( const account_statistics_object& s ) { return s.owner.instance.value; }
+      static values_type values( const account_statistics_object& s )
+      {
+         return std::make_tuple( s.total_core_in_orders, s.core_in_balance, s.total_core_inactive,
+                                 s.total_core_pob, s.total_core_pol, s.total_pob_value, s.total_pol_value,
+                                 s.last_vote_time, s.is_voting, s.has_cashback_vb );
+      }
+   };
+
+   typedef vote_change_index< account_object, account_vote_fields > account_vote_change_index;
+   typedef vote_change_index< account_statistics_object, account_statistics_vote_fields >
+           account_statistics_vote_change_index;
+
+   /// What an account added to a vote tally, and what that was computed from
+   struct cached_vote_tally_entry
+   {
+      bool              valid = false;
+      bool              adds = false; ///< Whether the account added to the tally at all
+      bool              member = false;
+      uint32_t          account_version = 0;
+      uint32_t          stats_version = 0;
+      account_id_type   opinion_account;
+      uint32_t          opinion_account_version = 0;
+      uint32_t          opinion_stats_version = 0;
+      time_point_sec    stake_last_vote_time;
+      time_point_sec    opinion_last_vote_time;
+      /// Recalculation steps the voting power was in, 0=witness, 1=committee, 2=worker, 3=delegator
+      std::array<uint8_t,4> recalc_steps = {};
+      vote_tally_entry  entry;
+   };
+
+   /**
+    *  @brief Remembers what each account added to the last vote tally
+    *
+    *  The next tally takes the entry of an account instead of computing it again if neither the account, its
+    *  statistics, nor those of the account voting for it changed in a way that matters, as counted by the
+    *  @ref vote_change_index of the account and account statistics indexes, and its voting power is still in
+    *  the same recalculation step.  Every check_interval tallies all accounts are recounted, and the entries
+    *  are compared against the recount.
+    */
+   class vote_tally_cache
+   {
+      public:
+         /// What all entries depend on
+         struct context_type
+         {
+            bool pob_activated = false;
+            bool hf2103_passed = false;
+            bool count_non_member_votes = false;
+
+            friend bool operator == ( const context_type& a, const context_type& b )
+            {
+               return std::tie( a.pob_activated, a.hf2103_passed, a.count_non_member_votes )
+                   == std::tie( b.pob_activated, b.hf2103_passed, b.count_non_member_votes );
+            }
+         };
+
+         /// Recount every @p interval tallies, 0 or 1 to always recount and not keep any entries
+         void set_check_interval( uint32_t interval )
+         {
+            check_interval = interval;
+            if( !enabled() )
+               entries = vector<cached_vote_tally_entry>();
+         }
+
+         bool enabled()const { return check_interval > 1; }
+
+         /**
+          *  Prepares a tally of the accounts with instances below @p num_accounts
+          *  @return whether it is a recount, i.e. the entries are only compared and replaced
+          */
+         bool start_tally( const context_type& new_context, uint64_t num_accounts )
+         {
+            mismatches = 0;
+            if( !( context == new_context ) )
+            {
+               entries.clear();
+               context = new_context;
+            }
+            entries.resize( num_accounts );
+            return ( ++tallies % check_interval ) == 0;
+         }
+
+         /// @return the entry of @p account, nullptr if it is not cached
+         cached_vote_tally_entry* find( const account_id_type& account )
+         {
+            return ( enabled() && account.instance.value < entries.size() ) ? &entries[account.instance.value]
+                                                                            : nullptr;
+         }
+
+         /// Called from the threads tallying when a recount differs from an entry that is still valid
+         void report_mismatch() { ++mismatches; }
+         uint64_t mismatch_count()const { return mismatches; }
+
+      private:
+         vector<cached_vote_tally_entry> entries;
+         context_type                    context;
+         uint32_t                        check_interval = 10;
+         uint64_t                        tallies = 0;
+         std::atomic<uint64_t>           mismatches { 0 };
+   };
+
+} } // graphene::chain
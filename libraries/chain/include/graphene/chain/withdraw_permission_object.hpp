@@ -2,6 +2,7 @@
 #pragma once
 
 #include <graphene/protocol/asset.hpp>
+#include <graphene/db/expiration_wheel.hpp>
 #include <graphene/db/generic_index.hpp>
 
 #include <boost/multi_index/composite_key.hpp>
@@ -68,7 +69,6 @@ namespace graphene { namespace chain {
 
    struct by_from;
    struct by_authorized;
-   struct by_expiration;
 
    using withdraw_permission_obj_mlt_idx = multi_index_container<
       withdraw_permission_object,
@@ -86,18 +86,16 @@ namespace graphene { namespace chain {
                member< withdraw_permission_object, account_id_type, &withdraw_permission_object::authorized_account >,
                member< object, object_id_type, &object::id >
             >
-         >,
-         ordered_unique< tag<by_expiration>,
-            composite_key< withdraw_permission_object,
-               member< withdraw_permission_object, time_point_sec, &withdraw_permission_object::expiration >,
-               member< object, object_id_type, &object::id >
-            >
          >
       >
    >;
 
    using withdraw_permission_index = generic_index<withdraw_permission_object, withdraw_permission_obj_mlt_idx>;
 
+   /// Withdraw permissions in the order they expire
+   using withdraw_permission_expiration_index = expiration_wheel< withdraw_permission_object,
+         member< withdraw_permission_object, time_point_sec, &withdraw_permission_object::expiration > >;
+
 
 } } // graphene::chain
 
@@ -286,6 +286,88 @@ share_type call_order_object::get_max_debt_to_cover( price match_price,
 
 } FC_CAPTURE_AND_RETHROW( (*this)(feed_price)(match_price)(maintenance_collateral_ratio) ) }
 
+void limit_order_book_index::object_inserted( const object& obj )
+{
+   add( static_cast< const limit_order_object& >( obj ) );
+}
+
+void limit_order_book_index::object_removed( const object& obj )
+{
+   const auto& order = static_cast< const limit_order_object& >( obj );
+   remove( order.get_id(), order.sell_price, order.for_sale );
+}
+
+void limit_order_book_index::about_to_modify( const object& before )
+{
+   const auto& order = static_cast< const limit_order_object& >( before );
+   orders_being_modified.emplace( order.get_id(), order.sell_price, order.for_sale );
+}
+
+void limit_order_book_index::object_modified( const object& after  )
+{
+   const auto& order = static_cast< const limit_order_object& >( after );
+   const auto& before = orders_being_modified.top();
+   FC_ASSERT( std::get<0>( before ) == order.get_id(), "Modification of ID is not supported!" );
+
+   const price& old_price = std::get<1>( before );
+   if( old_price == order.sell_price )
+   {
+      // Same level, which is the common case of a partial fill
+      auto& level = sides[ std::make_pair( order.sell_asset_id(), order.receive_asset_id() ) ]
+                         .find( order.sell_price )->second;
+      level.total_for_sale += order.for_sale - std::get<2>( before );
+   }
+   else
+   {
+      remove( order.get_id(), old_price, std::get<2>( before ) );
+      add( order );
+   }
+   orders_being_modified.pop();
+}
+
+void limit_order_book_index::add( const limit_order_object& order )
+{
+   auto& level = sides[ std::make_pair( order.sell_asset_id(), order.receive_asset_id() ) ][ order.sell_price ];
+   level.total_for_sale += order.for_sale;
+   level.orders[ order.get_id() ] = &order;
+}
+
+void limit_order_book_index::remove( const limit_order_id_type& id, const price& sell_price,
+                                     const share_type& for_sale )
+{
+   auto side_itr = sides.find( std::make_pair( sell_price.base.asset_id, sell_price.quote.asset_id ) );
+   if( side_itr == sides.end() )
+      return;
+   auto level_itr = side_itr->second.find( sell_price );
+   if( level_itr == side_itr->second.end() || level_itr->second.orders.erase( id ) == 0 )
+      return;
+   level_itr->second.total_for_sale -= for_sale;
+   if( !level_itr->second.orders.empty() )
+      return;
+   side_itr->second.erase( level_itr );
+   if( side_itr->second.empty() )
+      sides.erase( side_itr );
+}
+
+const limit_order_book_index::book_side* limit_order_book_index::find_side( const asset_id_type& sell,
+                                                                            const asset_id_type& receive )const
+{
+   auto itr = sides.find( std::make_pair( sell, receive ) );
+   if( itr == sides.end() )
+      return nullptr;
+   return &itr->second;
+}
+
+const limit_order_object* limit_order_book_index::best_order( const asset_id_type& sell,
+                                                              const asset_id_type& receive )const
+{
+   const book_side* side = find_side( sell, receive );
+   if( side == nullptr )
+      return nullptr;
+   // empty levels and sides are removed
+   return side->begin()->second.orders.begin()->second;
+}
+
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::limit_order_object,
                     (graphene::db::object),
                     (expiration)(seller)(for_sale)(sell_price)(filled_amount)(deferred_fee)(deferred_paid_fee)
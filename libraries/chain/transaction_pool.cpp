@@ -0,0 +1,93 @@
+/*
+ * Acloudbank
+ */
+#include <graphene/chain/transaction_pool.hpp>
+
+#include <fc/io/raw.hpp>
+
+namespace graphene { namespace chain {
+
+namespace {
+   struct operation_fee_visitor
+   {
+      typedef void result_type;
+
+      account_id_type payer;
+      asset           fee;
+
+      template<typename Op>
+      void operator()( const Op& op )
+      {
+         payer = op.fee_payer();
+         fee = op.fee;
+      }
+   };
+}
+
+pending_transaction::pending_transaction( const processed_transaction& t )
+   : trx( t ), id( t.id() ), expiration( t.expiration ), fee_payer( pending_fee_payer( t ) )
+{
+   packed_size = fc::raw::pack_size( static_cast<const signed_transaction&>( trx ) )
+               + fc::raw::pack_size( vector<operation_result>() );
+}
+
+account_id_type pending_fee_payer( const transaction& trx )
+{
+   if( trx.operations.empty() )
+      return account_id_type();
+   operation_fee_visitor v;
+   trx.operations.front().visit( v );
+   return v.payer;
+}
+
+vector<asset> operation_fees( const transaction& trx )
+{
+   vector<asset> result;
+   result.reserve( trx.operations.size() );
+   for( const auto& op : trx.operations )
+   {
+      operation_fee_visitor v;
+      op.visit( v );
+      result.push_back( v.fee );
+   }
+   return result;
+}
+
+const pending_transaction& transaction_pool::insert( pending_transaction&& trx )
+{
+   trx.sequence = _next_sequence++;
+   auto result = _index.insert( std::move(trx) );
+   FC_ASSERT( result.second, "Transaction is already pending" );
+   return *result.first;
+}
+
+bool transaction_pool::contains( const transaction_id_type& id )const
+{
+   const auto& idx = _index.get<by_id>();
+   return idx.find( id ) != idx.end();
+}
+
+size_t transaction_pool::count_by_fee_payer( const account_id_type& account )const
+{
+   return _index.get<by_fee_payer>().count( account );
+}
+
+size_t transaction_pool::remove_expired( fc::time_point_sec now )
+{
+   auto& idx = _index.get<by_expiration>();
+   size_t removed = 0;
+   while( !idx.empty() && idx.begin()->expiration < now )
+   {
+      idx.erase( idx.begin() );
+      ++removed;
+   }
+   return removed;
+}
+
+void transaction_pool::swap( transaction_pool& other )
+{
+   _index.swap( other._index );
+   std::swap( _next_sequence, other._next_sequence );
+}
+
+} } // graphene::chain
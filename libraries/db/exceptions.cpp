@@ -0,0 +1,14 @@
+/*
+ * Acloudbank
+ */
+#include <graphene/db/exceptions.hpp>
+
+namespace graphene { namespace db {
+
+   FC_IMPLEMENT_EXCEPTION( db_exception, 5000000, "Object Database Exception" )
+   FC_IMPLEMENT_DERIVED_EXCEPTION( incompatible_index_file_exception, db_exception, 5000001,
+                                   "incompatible object database file" )
+   FC_IMPLEMENT_DERIVED_EXCEPTION( corrupted_index_file_exception,    db_exception, 5000002,
+                                   "corrupted object database file" )
+
+} }
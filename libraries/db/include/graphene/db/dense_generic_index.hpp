@@ -0,0 +1,348 @@
+/*
+ * Acloudbank
+ */
+#pragma once
+#include <graphene/db/generic_index.hpp>
+
+#include <boost/iterator/indirect_iterator.hpp>
+#include <boost/mpl/pop_front.hpp>
+
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+namespace graphene { namespace db {
+
+   /**
+    * @brief Entry of the secondary indices of a @ref dense_generic_index
+    *
+    * Refers to an object in the dense storage.  The key extractors of boost::multi_index accept chained pointers,
+    * so the index specifiers written for a container of objects work unchanged on a container of handles.
+    */
+   template<typename ObjectType>
+   class dense_handle
+   {
+      public:
+         using element_type = const ObjectType;
+
+         explicit dense_handle( const ObjectType& obj ) : _obj( &obj ) {}
+
+         const ObjectType& operator*()const  { return *_obj; }
+         const ObjectType* operator->()const { return _obj; }
+
+      private:
+         const ObjectType* _obj;
+   };
+
+   /**
+    * @brief Read-only view of one secondary index of a @ref dense_generic_index
+    *
+    * Offers the lookup interface of a multi_index ordered index, with iterators that dereference to the objects
+    * instead of the handles.
+    */
+   template<typename ObjectType, typename Index>
+   class dense_index_view
+   {
+      public:
+         using iterator               = boost::indirect_iterator< typename Index::const_iterator, const ObjectType >;
+         using const_iterator         = iterator;
+         using reverse_iterator       = std::reverse_iterator<iterator>;
+         using const_reverse_iterator = reverse_iterator;
+         using key_type               = typename Index::key_type;
+         using size_type              = typename Index::size_type;
+
+         explicit dense_index_view( const Index& idx ) : _idx( idx ) {}
+
+         iterator         begin()const  { return iterator( _idx.begin() ); }
+         iterator         end()const    { return iterator( _idx.end() ); }
+         reverse_iterator rbegin()const { return reverse_iterator( end() ); }
+         reverse_iterator rend()const   { return reverse_iterator( begin() ); }
+         size_type        size()const   { return _idx.size(); }
+         bool             empty()const  { return _idx.empty(); }
+
+         template<typename Key>
+         iterator  find( const Key& k )const        { return iterator( _idx.find( k ) ); }
+         template<typename Key>
+         iterator  lower_bound( const Key& k )const { return iterator( _idx.lower_bound( k ) ); }
+         template<typename Key>
+         iterator  upper_bound( const Key& k )const { return iterator( _idx.upper_bound( k ) ); }
+         template<typename Key>
+         size_type count( const Key& k )const       { return _idx.count( k ); }
+         template<typename Key>
+         std::pair<iterator,iterator> equal_range( const Key& k )const
+         {
+            auto range = _idx.equal_range( k );
+            return std::make_pair( iterator( range.first ), iterator( range.second ) );
+         }
+
+      private:
+         const Index& _idx;
+   };
+
+   /**
+    *  An index for object types which are created in (nearly) increasing ID order and are rarely removed.
+    *
+    *  Objects live in chunks of 2^ChunkBits consecutive instances, so lookup by ID is an array access and objects
+    *  with neighbouring IDs share cache lines.  The remaining indices of MultiIndexType are maintained over small
+    *  handles into the chunks, the by_id index is dropped and replaced by the chunks themselves.  Chunks that
+    *  become empty are released.  A chunk with a single object left keeps all of its memory though, so types
+    *  that are pruned by age or per owner, like the operation histories, belong in a generic_index: their
+    *  survivors would spread over the chunks and memory would grow with every object ever created.
+    *
+    *  indices() returns the index itself: iterating it visits the objects in ID order, and get<Tag>() returns a
+    *  @ref dense_index_view of the other indices, so code written against a generic_index keeps working.
+    */
+   template<typename ObjectType, typename MultiIndexType, uint8_t ChunkBits = 10>
+   class dense_generic_index : public index
+   {
+      static_assert( std::is_same<typename MultiIndexType::key_type, object_id_type>::value,
+                     "First index of MultiIndexType MUST be object_id_type!" );
+      static_assert( ChunkBits > 0 && ChunkBits < 32, "Unreasonable chunk size" );
+
+      public:
+         using object_type = ObjectType;
+         using handle_type = dense_handle<ObjectType>;
+         using handle_index_type = multi_index_container< handle_type,
+               typename boost::mpl::pop_front< typename MultiIndexType::index_specifier_type_list >::type >;
+
+      private:
+         static constexpr uint64_t chunk_size = uint64_t(1) << ChunkBits;
+         static constexpr uint64_t chunk_mask = chunk_size - 1;
+
+         struct slot
+         {
+            typename std::aligned_storage< sizeof(ObjectType), alignof(ObjectType) >::type storage;
+            /// Entry in _handles, nullptr if the slot is empty
+            const handle_type* handle = nullptr;
+
+            ObjectType&       get()       { return *reinterpret_cast<ObjectType*>( &storage ); }
+            const ObjectType& get()const  { return *reinterpret_cast<const ObjectType*>( &storage ); }
+         };
+
+         struct chunk
+         {
+            slot     slots[chunk_size];
+            uint64_t used = 0;
+         };
+
+      public:
+         class const_iterator
+         {
+            public:
+               using iterator_category = std::forward_iterator_tag;
+               using value_type        = ObjectType;
+               using difference_type   = std::ptrdiff_t;
+               using pointer           = const ObjectType*;
+               using reference         = const ObjectType&;
+
+               const_iterator( const dense_generic_index& idx, uint64_t instance ) : _idx( &idx ), _instance( instance )
+               {
+                  skip_empty();
+               }
+
+               reference operator*()const  { return _idx->slot_at( _instance )->get(); }
+               pointer   operator->()const { return &_idx->slot_at( _instance )->get(); }
+
+               const_iterator& operator++()
+               {
+                  ++_instance;
+                  skip_empty();
+                  return *this;
+               }
+               const_iterator operator++(int)
+               {
+                  const_iterator result( *this );
+                  ++(*this);
+                  return result;
+               }
+
+               friend bool operator==( const const_iterator& a, const const_iterator& b )
+               { return a._instance == b._instance; }
+               friend bool operator!=( const const_iterator& a, const const_iterator& b )
+               { return a._instance != b._instance; }
+
+            private:
+               void skip_empty()
+               {
+                  const uint64_t end = _idx->_chunks.size() << ChunkBits;
+                  while( _instance < end )
+                  {
+                     const auto& c = _idx->_chunks[_instance >> ChunkBits];
+                     if( !c )
+                        _instance = ( ( _instance >> ChunkBits ) + 1 ) << ChunkBits;
+                     else if( c->slots[_instance & chunk_mask].handle == nullptr )
+                        ++_instance;
+                     else
+                        return;
+                  }
+                  _instance = end;
+               }
+
+               const dense_generic_index* _idx;
+               uint64_t                   _instance;
+         };
+
+         dense_generic_index() = default;
+         dense_generic_index( const dense_generic_index& ) = delete;
+         dense_generic_index& operator=( const dense_generic_index& ) = delete;
+
+         ~dense_generic_index() override
+         {
+            for( auto& c : _chunks )
+            {
+               if( !c )
+                  continue;
+               for( auto& s : c->slots )
+                  if( s.handle != nullptr )
+                     s.get().~ObjectType();
+            }
+         }
+
+         const object& insert( object&& obj )override
+         {
+            assert( nullptr != dynamic_cast<ObjectType*>(&obj) );
+            return emplace( std::move( static_cast<ObjectType&>(obj) ) );
+         }
+
+         const object&  create(const std::function<void(object&)>& constructor )override
+         {
+            ObjectType item;
+            item.id = get_next_id();
+            constructor( item );
+            const object& result = emplace( std::move(item) );
+            use_next_id();
+            return result;
+         }
+
+         void modify( const object& obj, const std::function<void(object&)>& m )override
+         {
+            assert(nullptr != dynamic_cast<const ObjectType*>(&obj));
+            const object_id_type id = obj.id;
+            slot* s = slot_at( id.instance() );
+            FC_ASSERT( s != nullptr && s->handle != nullptr, "Could not find object ${id}", ("id",id) );
+            std::exception_ptr exc;
+            try {
+               m( s->get() );
+            } catch (fc::exception& e) {
+               exc = std::current_exception();
+               elog("Exception while modifying object: ${e} -- object may be corrupted", ("e", e));
+            } catch (...) {
+               exc = std::current_exception();
+               elog("Unknown exception while modifying object");
+            }
+            // The handle itself does not change, but the keys behind it may have
+            auto ok = _handles.modify( _handles.iterator_to( *s->handle ), []( handle_type& ){} );
+            if( !ok ) // the handle has been dropped from the indices, drop the object as well
+               destroy( id.instance(), *s );
+            if (exc)
+                std::rethrow_exception(exc);
+            FC_ASSERT(ok, "Could not modify object, most likely an index constraint was violated");
+            FC_ASSERT( s->get().id == id, "Modification of ID is not supported!" );
+         }
+
+         void remove( const object& obj )override
+         {
+            slot* s = slot_at( obj.id.instance() );
+            FC_ASSERT( s != nullptr && s->handle != nullptr, "Could not find object ${id}", ("id",obj.id) );
+            _handles.erase( _handles.iterator_to( *s->handle ) );
+            destroy( obj.id.instance(), *s );
+         }
+
+         const object* find( object_id_type id )const override
+         {
+            const slot* s = slot_at( id.instance() );
+            if( s == nullptr || s->handle == nullptr ) return nullptr;
+            return &s->get();
+         }
+
+         void inspect_all_objects(std::function<void (const object&)> inspector)const override
+         {
+            try {
+               for( const auto& o : *this )
+                  inspector(o);
+            } FC_CAPTURE_AND_RETHROW()
+         }
+
+         /** Called before loading @p count objects */
+         void reserve( size_t count ) { _chunks.reserve( ( count >> ChunkBits ) + 1 ); }
+
+         /// Container interface, compatible with the one of generic_index::indices()
+         /// @{
+         const dense_generic_index& indices()const { return *this; }
+
+         const_iterator begin()const { return const_iterator( *this, 0 ); }
+         const_iterator end()const   { return const_iterator( *this, _chunks.size() << ChunkBits ); }
+         size_t         size()const  { return _size; }
+         bool           empty()const { return 0 == _size; }
+
+         template<typename Tag>
+         dense_index_view< ObjectType, typename handle_index_type::template index<Tag>::type > get()const
+         {
+            return dense_index_view< ObjectType, typename handle_index_type::template index<Tag>::type >(
+                      _handles.template get<Tag>() );
+         }
+         /// @}
+
+      private:
+         const slot* slot_at( uint64_t instance )const
+         {
+            const uint64_t c = instance >> ChunkBits;
+            if( c >= _chunks.size() || !_chunks[c] ) return nullptr;
+            return &_chunks[c]->slots[instance & chunk_mask];
+         }
+         slot* slot_at( uint64_t instance )
+         {
+            return const_cast<slot*>( static_cast<const dense_generic_index*>(this)->slot_at( instance ) );
+         }
+
+         const ObjectType& emplace( ObjectType&& obj )
+         {
+            const uint64_t instance = obj.id.instance();
+            const uint64_t c = instance >> ChunkBits;
+            if( c >= _chunks.size() )
+               _chunks.resize( c + 1 );
+            if( !_chunks[c] )
+               _chunks[c] = std::make_unique<chunk>();
+            slot& s = _chunks[c]->slots[instance & chunk_mask];
+            FC_ASSERT( s.handle == nullptr,
+                       "Could not insert object, most likely a uniqueness constraint was violated" );
+            ObjectType* result = new( &s.storage ) ObjectType( std::move(obj) );
+            ++_chunks[c]->used;
+            ++_size;
+            auto insert_result = _handles.insert( handle_type( *result ) );
+            if( !insert_result.second )
+            {
+               result->~ObjectType();
+               release_slot( instance );
+               FC_THROW_EXCEPTION( fc::assert_exception,
+                                   "Could not insert object, most likely a uniqueness constraint was violated" );
+            }
+            s.handle = &*insert_result.first;
+            return *result;
+         }
+
+         void destroy( uint64_t instance, slot& s )
+         {
+            s.handle = nullptr;
+            s.get().~ObjectType();
+            release_slot( instance );
+         }
+
+         void release_slot( uint64_t instance )
+         {
+            --_size;
+            auto& c = _chunks[instance >> ChunkBits];
+            if( 0 == --c->used )
+            {
+               c.reset();
+               while( !_chunks.empty() && !_chunks.back() )
+                  _chunks.pop_back();
+            }
+         }
+
+         std::vector< std::unique_ptr<chunk> > _chunks;
+         handle_index_type                      _handles;
+         size_t                                 _size = 0;
+   };
+
+} }
@@ -0,0 +1,15 @@
+/*
+ * Acloudbank
+ */
+#pragma once
+#include <fc/exception/exception.hpp>
+
+namespace graphene { namespace db {
+
+   FC_DECLARE_EXCEPTION( db_exception, 5000000 )
+   /// The file of an index was written by an incompatible version, detected before any object is loaded
+   FC_DECLARE_DERIVED_EXCEPTION( incompatible_index_file_exception, db_exception, 5000001 )
+   /// The file of an index is damaged
+   FC_DECLARE_DERIVED_EXCEPTION( corrupted_index_file_exception,    db_exception, 5000002 )
+
+} }
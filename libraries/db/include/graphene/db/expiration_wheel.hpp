@@ -0,0 +1,152 @@
+/*
+ * Acloudbank
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/time.hpp>
+
+#include <map>
+#include <stack>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @brief A secondary index that yields the objects of a primary index in the order they expire
+    *
+    *  Objects expiring within the next 2^NearBits seconds after the cursor are kept in a wheel of one bucket per
+    *  second, later ones in a tree from which they move into the wheel as the cursor comes close.  Objects that
+    *  expire before the cursor, which happens when removals are undone, are kept in a separate tree.  Looking up
+    *  the next expired object is a bucket lookup, and the wheel is only touched by objects created or removed,
+    *  or whose expiration changes.
+    *
+    *  The objects of a bucket are sorted by ID, so the objects are yielded in the order of a composite
+    *  (expiration, ID) index.
+    *
+    *  @tparam ExpirationExtractor a key extractor of Object yielding an fc::time_point_sec
+    */
+   template< typename Object, typename ExpirationExtractor, uint8_t NearBits = 10 >
+   class expiration_wheel : public secondary_index
+   {
+      public:
+         expiration_wheel() : _near( near_size ) {}
+
+         virtual void object_inserted( const object& obj ) override
+         {
+            const Object& o = static_cast<const Object&>( obj );
+            add( seconds( o ), o );
+         }
+
+         virtual void object_removed( const object& obj ) override
+         {
+            const Object& o = static_cast<const Object&>( obj );
+            remove( seconds( o ), o.id );
+         }
+
+         virtual void about_to_modify( const object& before ) override
+         {
+            _being_modified.emplace( before.id, seconds( static_cast<const Object&>( before ) ) );
+         }
+
+         virtual void object_modified( const object& after  ) override
+         {
+            const Object& o = static_cast<const Object&>( after );
+            FC_ASSERT( _being_modified.top().first == o.id, "Modification of ID is not supported!" );
+            const uint64_t before = _being_modified.top().second;
+            _being_modified.pop();
+            if( before == seconds( o ) )
+               return;
+            remove( before, o.id );
+            add( seconds( o ), o );
+         }
+
+         /**
+          *  @return the object that expires first among those expiring at or before @p deadline, nullptr if there
+          *          is none.  The caller is expected to remove or prolong it before asking for the next one.
+          */
+         const Object* next_expired( const fc::time_point_sec& deadline )const
+         {
+            const uint64_t last = deadline.sec_since_epoch();
+            if( !_overdue.empty() )
+               return ( _overdue.begin()->first.first <= last ) ? _overdue.begin()->second : nullptr;
+            while( _cursor <= last )
+            {
+               if( _near_count == 0 )
+               {
+                  // nothing in the wheel, skip ahead to the first later object or past the deadline
+                  _cursor = _far.empty() ? last + 1 : std::min( last + 1, _far.begin()->first.first );
+                  pull_near();
+                  if( _near_count == 0 )
+                     return nullptr;
+                  continue;
+               }
+               const auto& bucket = _near[ _cursor & near_mask ];
+               if( !bucket.empty() )
+                  return bucket.begin()->second;
+               ++_cursor;
+               pull_near();
+            }
+            return nullptr;
+         }
+
+         size_t size()const { return _overdue.size() + _near_count + _far.size(); }
+
+      private:
+         static constexpr uint64_t near_size = uint64_t(1) << NearBits;
+         static constexpr uint64_t near_mask = near_size - 1;
+
+         typedef std::map< std::pair< uint64_t, object_id_type >, const Object* > tree_type;
+
+         static uint64_t seconds( const Object& o )
+         {
+            return ExpirationExtractor()( o ).sec_since_epoch();
+         }
+
+         void add( uint64_t when, const Object& o )
+         {
+            if( when < _cursor )
+               _overdue[ std::make_pair( when, o.id ) ] = &o;
+            else if( when < _cursor + near_size )
+            {
+               _near[ when & near_mask ][ o.id ] = &o;
+               ++_near_count;
+            }
+            else
+               _far[ std::make_pair( when, o.id ) ] = &o;
+         }
+
+         void remove( uint64_t when, const object_id_type& id )
+         {
+            if( when < _cursor )
+               _overdue.erase( std::make_pair( when, id ) );
+            else if( when < _cursor + near_size )
+               _near_count -= _near[ when & near_mask ].erase( id );
+            else
+               _far.erase( std::make_pair( when, id ) );
+         }
+
+         /// Moves the objects that came into the range of the wheel out of the far tree
+         void pull_near()const
+         {
+            while( !_far.empty() && _far.begin()->first.first < _cursor + near_size )
+            {
+               const auto itr = _far.begin();
+               _near[ itr->first.first & near_mask ][ itr->first.second ] = itr->second;
+               ++_near_count;
+               _far.erase( itr );
+            }
+         }
+
+         /** Only moves forward, looking up expired objects is a const operation */
+         mutable uint64_t                                                          _cursor = 0;
+         mutable std::vector< fc::flat_map< object_id_type, const Object* > >     _near;
+         mutable size_t                                                            _near_count = 0;
+         mutable tree_type                                                         _far;
+         tree_type                                                                 _overdue;
+         std::stack< std::pair< object_id_type, uint64_t > >                       _being_modified;
+   };
+
+} } // graphene::db
@@ -94,6 +94,9 @@ namespace graphene { namespace db {
 
          const index_type& indices()const { return _indices; }
 
+         /** Called before loading @p count objects, ordered containers cannot preallocate */
+         void reserve( size_t count ) {}
+
       private:
          index_type  _indices;
    };
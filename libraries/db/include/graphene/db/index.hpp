@@ -2,15 +2,23 @@
  * Acloudbank
  */
 #pragma once
+#include <graphene/db/exceptions.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/object_schema.hpp>
+#include <graphene/db/undo_database.hpp>
 
+#include <fc/crypto/city.hpp>
 #include <fc/interprocess/file_mapping.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/io/json.hpp>
 #include <fc/crypto/sha256.hpp>
 
+#include <algorithm>
+#include <exception>
 #include <fstream>
 #include <stack>
+#include <thread>
+#include <unordered_set>
 
 namespace graphene { namespace db {
    class object_database;
@@ -73,10 +81,41 @@ namespace graphene { namespace db {
          virtual const object&  create( const std::function<void(object&)>& constructor ) = 0;
 
          /**
-          *  Opens the index loading objects from a file
+          *  Opens the index loading objects from a file, checking the checksum of each block of the file right
+          *  before its objects are loaded
+          *  @throws incompatible_index_file_exception if the file was written by an incompatible version
+          *  @throws corrupted_index_file_exception if the file is damaged, some objects may have been loaded then
           */
          virtual void open( const fc::path& db ) = 0;
-         virtual void save( const fc::path& db ) = 0;
+         /**
+          *  Removes all objects without undo history and resets the next ID, e.g. to drop what open() loaded
+          *  from a damaged file
+          */
+         virtual void unload() = 0;
+         /**
+          *  Saves all objects to a file
+          *  @param values_before if given, the objects it contains are saved with these values instead of the
+          *         current ones, and remain tracked as changed for save_delta()
+          */
+         virtual void save( const fc::path& db, const undo_values_before* values_before = nullptr ) = 0;
+
+         /**
+          *  Writes the objects created, modified or removed since the last call to save_delta() or clear_delta()
+          *  to a file, see object_database::checkpoint()
+          *  @param values_before as for save()
+          *  @return false if nothing has changed, no file is written in that case
+          */
+         virtual bool save_delta( const fc::path& db, const undo_values_before* values_before = nullptr ) = 0;
+         /**
+          *  Applies a file written by save_delta() on top of the objects loaded by open()
+          *  @throws incompatible_index_file_exception if the file was written by an incompatible version
+          *  @throws corrupted_index_file_exception if the file does not match its checksum or is malformed
+          */
+         virtual void open_delta( const fc::path& db ) = 0;
+         /**
+          *  Forgets the changes tracked for save_delta(), except for the objects contained in @p values_before
+          */
+         virtual void clear_delta( const undo_values_before* values_before = nullptr ) = 0;
 
 
 
@@ -114,6 +153,14 @@ namespace graphene { namespace db {
 
          virtual void object_from_variant( const fc::variant& var, object& obj, uint32_t max_depth )const = 0;
          virtual void object_default( object& obj )const = 0;
+         /** Replaces the content of obj with the serialized object in data */
+         virtual void object_from_packed( const std::vector<char>& data, object& obj )const = 0;
+
+         /**
+          * @return true if committed undo states should keep modified objects of this index as binary deltas
+          * against their current value instead of full copies
+          */
+         virtual bool uses_delta_undo()const { return false; }
    };
 
    class secondary_index
@@ -169,8 +216,17 @@ namespace graphene { namespace db {
       protected:
          std::vector< std::shared_ptr<index_observer> >   _observers;
          std::vector< std::unique_ptr<secondary_index> >  _sindex;
+         /// IDs of the objects changed since the last checkpoint, only tracked if checkpoints are enabled
+         std::unordered_set<object_id_type>               _dirty;
+
+         /// Takes up to @p wanted threads from the object database's budget for loading large index files
+         /// @return the number of threads granted, to be given back by release_load_threads()
+         uint32_t acquire_load_threads( uint32_t wanted );
+         void release_load_threads( uint32_t count );
 
       private:
+         void mark_dirty( const object& obj );
+
          object_database& _db;
    };
 
@@ -319,10 +375,10 @@ namespace graphene { namespace db {
             return DerivedIndex::find( id );
          }
 
+         /** @return hash of the serialized layout of the objects, see object_schema_hash() */
          fc::sha256 get_object_version()const
          {
-            std::string desc = "1.0";
-            return fc::sha256::hash(desc);
+            return object_schema_hash<object_type>();
          }
 
          void open( const fc::path& db )override
@@ -331,41 +387,188 @@ namespace graphene { namespace db {
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
             fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
-            fc::sha256 open_ver;
 
-            fc::raw::unpack(ds, _next_id);
-            fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(),
-                       "Incompatible Version, the serialization of objects in this index has changed" );
-            std::vector<char> tmp;
-            while( ds.remaining() > 0 )
+            const uint64_t count = read_header( ds, db, _next_id );
+            auto blocks = split_blocks( ds, db, count );
+            DerivedIndex::reserve( count );
+            if( count >= parallel_load_threshold )
+               load_parallel( blocks, db );
+            else
             {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
+               for( size_t b = 0; b < blocks.size(); ++b )
+               {
+                  check_block( blocks[b], db, b );
+                  while( blocks[b].records.remaining() > 0 )
+                     load_record( blocks[b].records );
+               }
             }
          }
 
-         void save( const fc::path& db ) override
+         void unload()override
+         {
+            std::vector<const object*> objects;
+            this->inspect_all_objects( [&objects]( const object& o ) { objects.push_back( &o ); } );
+            for( const object* obj : objects )
+            {
+               for( const auto& item : _sindex )
+                  item->object_removed( *obj );
+               DerivedIndex::remove( *obj );
+            }
+            _next_id = object_id_type( object_type::space_id, object_type::type_id, 0 );
+            _dirty.clear();
+         }
+
+         void save( const fc::path& db, const undo_values_before* values_before = nullptr ) override
          {
             std::ofstream out( db.generic_string(),
                                std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
             FC_ASSERT( out );
-            auto ver  = get_object_version();
-            fc::raw::pack( out, _next_id );
-            fc::raw::pack( out, ver );
-            this->inspect_all_objects( [&out]( const object& o ) {
-                auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+            fc::raw::pack( out, file_magic );
+            fc::raw::pack( out, file_format_version );
+            fc::raw::pack( out, get_object_version() );
+            fc::raw::pack( out, next_id_before( values_before ) );
+            // the object count is only known at the end, reserve its place
+            const auto count_pos = out.tellp();
+            uint64_t count = 0;
+            fc::raw::pack( out, count );
+
+            std::vector<char> block;
+            uint32_t block_records = 0;
+            const auto write_block = [&out,&block,&block_records]() {
+               fc::raw::pack( out, block_records );
+               fc::raw::pack( out, uint32_t( block.size() ) );
+               out.write( block.data(), block.size() );
+               fc::raw::pack( out, uint64_t( fc::city_hash64( block.data(), block.size() ) ) );
+               block.clear();
+               block_records = 0;
+            };
+            const auto write_record = [&]( const std::vector<char>& vec ) {
+               const auto packed_vec = fc::raw::pack( vec );
+               block.insert( block.end(), packed_vec.begin(), packed_vec.end() );
+               ++count;
+               if( ++block_records == records_per_block )
+                  write_block();
+            };
+            this->inspect_all_objects( [&]( const object& o ) {
+               if( values_before == nullptr || values_before->objects.find( o.id ) == values_before->objects.end() )
+                  write_record( fc::raw::pack( static_cast<const object_type&>(o) ) );
             });
+            const auto earlier = values_before_range( values_before );
+            for( auto itr = earlier.first; itr != earlier.second; ++itr )
+               if( itr->second.valid() )
+                  write_record( *itr->second );
+            if( block_records > 0 )
+               write_block();
+            out.seekp( count_pos );
+            fc::raw::pack( out, count );
+            out.flush();
+            FC_ASSERT( out.good(), "Failed to write ${f}", ("f",db) );
+         }
+
+         bool save_delta( const fc::path& db, const undo_values_before* values_before = nullptr )override
+         {
+            const auto earlier = values_before_range( values_before );
+            if( _dirty.empty() && earlier.first == earlier.second )
+               return false;
+            // the file is checksummed as a whole, so it is built in memory first
+            std::vector<char> data;
+            const auto append = [&data]( const auto& value ) {
+               const auto packed = fc::raw::pack( value );
+               data.insert( data.end(), packed.begin(), packed.end() );
+            };
+            append( next_id_before( values_before ) );
+            append( get_object_version() );
+            // a removed or not yet created object is written as its ID without data
+            const auto write_record = [&append]( object_id_type id, const std::vector<char>* record ) {
+               append( id );
+               append( record != nullptr );
+               if( record != nullptr )
+                  append( *record );
+            };
+            for( const auto& id : _dirty )
+            {
+               if( values_before != nullptr && values_before->objects.find( id ) != values_before->objects.end() )
+                  continue;
+               const object* obj = find( id );
+               const auto record = obj != nullptr ? fc::raw::pack( static_cast<const object_type&>(*obj) )
+                                                  : std::vector<char>();
+               write_record( id, obj != nullptr ? &record : nullptr );
+            }
+            for( auto itr = earlier.first; itr != earlier.second; ++itr )
+               write_record( itr->first, itr->second.valid() ? &*itr->second : nullptr );
+
+            std::ofstream out( db.generic_string(),
+                               std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+            FC_ASSERT( out );
+            out.write( data.data(), data.size() );
+            fc::raw::pack( out, uint64_t( fc::city_hash64( data.data(), data.size() ) ) );
+            out.flush();
+            FC_ASSERT( out.good(), "Failed to write ${f}", ("f",db) );
+            clear_delta( values_before );
+            return true;
+         }
+
+         void open_delta( const fc::path& db )override
+         {
+            const uint64_t size = fc::file_size( db );
+            uint64_t checksum = 0;
+            if( size < sizeof(checksum) )
+               FC_THROW_EXCEPTION( corrupted_index_file_exception, "Truncated file ${f}", ("f",db) );
+            fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
+            fc::mapped_region mr( fm, fc::read_only, 0, size );
+            const char* data = (const char*)mr.get_address();
+            const uint64_t data_size = size - sizeof(checksum);
+            fc::datastream<const char*> checksum_ds( data + data_size, sizeof(checksum) );
+            fc::raw::unpack( checksum_ds, checksum );
+            if( checksum != uint64_t( fc::city_hash64( data, data_size ) ) )
+               FC_THROW_EXCEPTION( corrupted_index_file_exception, "Checksum mismatch in ${f}", ("f",db) );
+
+            fc::datastream<const char*> ds( data, data_size );
+            fc::sha256 open_ver;
+            try {
+               fc::raw::unpack(ds, _next_id);
+               fc::raw::unpack(ds, open_ver);
+            } catch( const fc::exception& ) {
+               FC_THROW_EXCEPTION( corrupted_index_file_exception, "Truncated header in ${f}", ("f",db) );
+            }
+            if( open_ver != get_object_version() )
+               FC_THROW_EXCEPTION( incompatible_index_file_exception,
+                                   "The serialization of the objects in ${f} has changed", ("f",db) );
+            try {
+               while( ds.remaining() > 0 )
+               {
+                  object_id_type id;
+                  bool present;
+                  fc::raw::unpack( ds, id );
+                  fc::raw::unpack( ds, present );
+                  const object* existing = find( id );
+                  if( existing != nullptr )
+                  {
+                     for( const auto& item : _sindex )
+                        item->object_removed( *existing );
+                     DerivedIndex::remove( *existing );
+                  }
+                  if( present )
+                     load_record( ds );
+               }
+            } catch( const fc::exception& e ) {
+               FC_THROW_EXCEPTION( corrupted_index_file_exception, "Malformed record in ${f}: ${e}",
+                                   ("f",db)("e",e.to_string()) );
+            }
+         }
+
+         void clear_delta( const undo_values_before* values_before = nullptr )override
+         {
+            _dirty.clear();
+            // these have been saved with earlier values, so their current ones are still to be saved
+            const auto earlier = values_before_range( values_before );
+            for( auto itr = earlier.first; itr != earlier.second; ++itr )
+               _dirty.insert( itr->first );
          }
 
          const object&  load( const std::vector<char>& data )override
          {
-            const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
-            return result;
+            return insert_loaded( fc::raw::unpack<object_type>( data ) );
          }
 
 
@@ -429,7 +632,224 @@ namespace graphene { namespace db {
             obj.id = id;
          }
 
+         void object_from_packed( const std::vector<char>& data, object& obj )const override
+         {
+            object_type* result = dynamic_cast<object_type*>( &obj );
+            FC_ASSERT( result != nullptr );
+            (*result) = fc::raw::unpack<object_type>( data );
+         }
+
+         /**
+          * Lets committed undo states store modified objects of this index as deltas.  Worthwhile for objects
+          * which are modified often but only in a few bytes, e.g. balances.
+          */
+         void set_delta_undo( bool enabled ) { _delta_undo = enabled; }
+         bool uses_delta_undo()const override { return _delta_undo; }
+
       private:
+         /// Identifies the files written by save()
+         static constexpr uint32_t file_magic = 0x4a424f47; // "GOBJ"
+         /// Version of the file layout, independent of the layout of the objects
+         static constexpr uint32_t file_format_version = 2;
+         /// Records per checksummed block of a file
+         static constexpr uint32_t records_per_block = 4096;
+         /// Index files with at least this many objects are deserialized by several threads
+         static constexpr uint64_t parallel_load_threshold = 100000;
+
+         using values_before_iterator = decltype( undo_values_before::objects )::const_iterator;
+
+         /** @return the objects of this index contained in @p values_before, which may be null */
+         std::pair<values_before_iterator, values_before_iterator> values_before_range(
+               const undo_values_before* values_before )const
+         {
+            if( values_before == nullptr )
+               return {};
+            const object_id_type first( object_type::space_id, object_type::type_id, 0 );
+            const auto begin = values_before->objects.lower_bound( first );
+            auto end = begin;
+            while( end != values_before->objects.end() && end->first.space() == object_type::space_id
+                   && end->first.type() == object_type::type_id )
+               ++end;
+            return { begin, end };
+         }
+
+         /** @return the next ID as of the state described by @p values_before, which may be null */
+         object_id_type next_id_before( const undo_values_before* values_before )const
+         {
+            if( values_before == nullptr )
+               return _next_id;
+            const auto itr = values_before->next_ids.find(
+                  object_id_type( object_type::space_id, object_type::type_id, 0 ) );
+            return itr != values_before->next_ids.end() ? itr->second : _next_id;
+         }
+
+         /**
+          *  Reads and checks the file header
+          *  @return the number of objects in the file
+          */
+         uint64_t read_header( fc::datastream<const char*>& ds, const fc::path& db, object_id_type& next_id )const
+         {
+            uint32_t magic = 0;
+            uint32_t format_version = 0;
+            fc::sha256 schema;
+            uint64_t count = 0;
+            if( ds.remaining() >= sizeof(magic) + sizeof(format_version) )
+            {
+               fc::raw::unpack( ds, magic );
+               fc::raw::unpack( ds, format_version );
+            }
+            if( magic != file_magic || format_version != file_format_version )
+               FC_THROW_EXCEPTION( incompatible_index_file_exception, "Unknown file format in ${f}",
+                                   ("f",db)("format_version",format_version) );
+            try {
+               fc::raw::unpack( ds, schema );
+               fc::raw::unpack( ds, next_id );
+               fc::raw::unpack( ds, count );
+            } catch( const fc::exception& ) {
+               FC_THROW_EXCEPTION( corrupted_index_file_exception, "Truncated header in ${f}", ("f",db) );
+            }
+            if( schema != get_object_version() )
+               FC_THROW_EXCEPTION( incompatible_index_file_exception,
+                                   "The serialization of the objects in ${f} has changed", ("f",db) );
+            return count;
+         }
+
+         /// A block of records of a file and the checksum stored for it
+         struct file_block
+         {
+            fc::datastream<const char*> records;
+            uint64_t                    checksum;
+         };
+
+         /**
+          *  Splits the remainder of a file into its blocks of records, checking the structure but not the checksums
+          */
+         static std::vector< file_block > split_blocks( fc::datastream<const char*>& ds, const fc::path& db,
+                                                        uint64_t count )
+         {
+            std::vector< file_block > blocks;
+            blocks.reserve( count / records_per_block + 1 );
+            uint64_t records = 0;
+            while( ds.remaining() > 0 )
+            {
+               uint32_t block_records = 0;
+               uint32_t size = 0;
+               uint64_t checksum = 0;
+               if( ds.remaining() < sizeof(block_records) + sizeof(size) )
+                  FC_THROW_EXCEPTION( corrupted_index_file_exception, "Truncated block in ${f}", ("f",db) );
+               fc::raw::unpack( ds, block_records );
+               fc::raw::unpack( ds, size );
+               if( ds.remaining() < uint64_t(size) + sizeof(checksum) )
+                  FC_THROW_EXCEPTION( corrupted_index_file_exception, "Truncated block in ${f}", ("f",db) );
+               const char* data = ds.pos();
+               ds.skip( size );
+               fc::raw::unpack( ds, checksum );
+               blocks.push_back( { fc::datastream<const char*>( data, size ), checksum } );
+               records += block_records;
+            }
+            if( records != count )
+               FC_THROW_EXCEPTION( corrupted_index_file_exception,
+                                   "${f} should contain ${n} objects but contains ${r}",
+                                   ("f",db)("n",count)("r",records) );
+            return blocks;
+         }
+
+         /// @throws corrupted_index_file_exception if the records of @p block do not match its checksum
+         static void check_block( const file_block& block, const fc::path& db, size_t number )
+         {
+            if( block.checksum != uint64_t( fc::city_hash64( block.records.pos(), block.records.remaining() ) ) )
+               FC_THROW_EXCEPTION( corrupted_index_file_exception, "Checksum mismatch in block ${b} of ${f}",
+                                   ("b",number)("f",db) );
+         }
+
+         /// Reads the size prefix of a record in @p ds and returns the record, advancing @p ds past it
+         static fc::datastream<const char*> next_record( fc::datastream<const char*>& ds )
+         {
+            fc::unsigned_int size;
+            fc::raw::unpack( ds, size );
+            FC_ASSERT( size.value <= ds.remaining(), "Truncated object record" );
+            fc::datastream<const char*> record( ds.pos(), size.value );
+            ds.skip( size.value );
+            return record;
+         }
+
+         /** Unpacks one record straight from the mapped file and moves the object into the index */
+         const object& load_record( fc::datastream<const char*>& ds )
+         {
+            auto record = next_record( ds );
+            object_type obj;
+            fc::raw::unpack( record, obj );
+            return insert_loaded( std::move(obj) );
+         }
+
+         const object& insert_loaded( object_type&& obj )
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
+         }
+
+         /**
+          *  Deserializes the blocks of a large index file on this thread and as many more as the object database's
+          *  thread budget grants, which is shared by all indexes loading at the same time.  The containers are not
+          *  thread safe, so the objects are inserted in file order once a round of blocks is complete.  Plain
+          *  threads are used, as this runs inside a task of the fc thread pool already.
+          */
+         void load_parallel( std::vector< file_block >& blocks, const fc::path& db )
+         {
+            struct load_threads
+            {
+               primary_index& idx;
+               const uint32_t count;
+               ~load_threads() { idx.release_load_threads( count ); }
+            } extra{ *this, acquire_load_threads( uint32_t( blocks.size() - 1 ) ) };
+
+            const size_t workers = extra.count + 1;
+            std::vector< std::vector< object_type > > objects( workers );
+            auto load_block = [&blocks,&objects,&db]( size_t b, size_t w ) {
+               check_block( blocks[b], db, b );
+               auto& block = blocks[b].records;
+               objects[w].clear();
+               objects[w].reserve( records_per_block );
+               while( block.remaining() > 0 )
+               {
+                  auto record = next_record( block );
+                  objects[w].emplace_back();
+                  fc::raw::unpack( record, objects[w].back() );
+               }
+            };
+            for( size_t first = 0; first < blocks.size(); first += workers )
+            {
+               const size_t round = std::min( workers, blocks.size() - first );
+               std::vector< std::thread > threads;
+               std::vector< std::exception_ptr > errors( round );
+               for( size_t w = 1; w < round; ++w )
+                  threads.emplace_back( [&load_block,&errors,first,w]() {
+                     try {
+                        load_block( first + w, w );
+                     } catch( ... ) {
+                        errors[w] = std::current_exception();
+                     }
+                  });
+               try {
+                  load_block( first, 0 );
+               } catch( ... ) {
+                  errors[0] = std::current_exception();
+               }
+               for( auto& t : threads )
+                  t.join();
+               for( const auto& e : errors )
+                  if( e )
+                     std::rethrow_exception( e );
+
+               for( size_t w = 0; w < round; ++w )
+                  for( auto& obj : objects[w] )
+                     insert_loaded( std::move(obj) );
+            }
+         }
+
+         bool                                           _delta_undo = false;
          object_id_type                                 _next_id;
          const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
    };
@@ -4,6 +4,7 @@
 #pragma once
 #include <boost/multiprecision/integer.hpp>
 #include <graphene/protocol/object_id.hpp>
+#include <graphene/db/undo_arena.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/crypto/city.hpp>
 
@@ -51,6 +52,7 @@ namespace graphene { namespace db {
          /// these methods are implemented for derived classes by inheriting base_abstract_object<DerivedClass>
          /// @{
          virtual std::unique_ptr<object> clone()const = 0;
+         virtual object*                 clone_into( undo_arena& arena )const = 0;
          virtual void                    move_from( object& obj ) = 0;
          virtual fc::variant             to_variant()const  = 0;
          virtual std::vector<char>       pack()const = 0;
@@ -74,6 +76,11 @@ namespace graphene { namespace db {
             return std::make_unique<DerivedClass>( *static_cast<const DerivedClass*>(this) );
          }
 
+         object* clone_into( undo_arena& arena )const override
+         {
+            return arena.construct<DerivedClass>( *static_cast<const DerivedClass*>(this) );
+         }
+
          void    move_from( object& obj ) override
          {
             static_cast<DerivedClass&>(*this) = std::move( static_cast<DerivedClass&>(obj) );
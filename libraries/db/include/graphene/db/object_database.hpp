@@ -8,6 +8,7 @@
 
 #include <fc/log/logger.hpp>
 
+#include <atomic>
 #include <map>
 
 namespace graphene { namespace db {
@@ -34,11 +35,31 @@ namespace graphene { namespace db {
 
          /**
           * Saves the complete state of the object_database to disk, this could take a while
+          * @param values_before if given, the state before the undo states it was collected from is saved instead
+          *        of the current one, see undo_database::get_values_before()
           */
-         void flush();
+         void flush( const undo_values_before* values_before = nullptr );
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
+         /**
+          * Enables incremental checkpoints: the indexes keep track of the objects that change, and checkpoint()
+          * saves only those as a new segment on top of the last flush().  After @p max_segments segments the
+          * next checkpoint is a full flush() again.  0 disables checkpoints.
+          *
+          * Changes made before this is called are not tracked, so unless it is called before open() the first
+          * checkpoint is a full flush().
+          */
+         void enable_checkpoints( uint32_t max_segments );
+         bool checkpoints_enabled()const { return _max_checkpoint_segments > 0; }
+
+         /**
+          * Saves the changes since the last flush() or checkpoint() to disk.  Segments are made visible by an
+          * atomic rename, so after a crash open() restores the state of the last completed checkpoint.
+          * @param values_before as for flush()
+          */
+         void checkpoint( const undo_values_before* values_before = nullptr );
+
          template<typename T, typename F>
          const T& create( F&& constructor )
          {
@@ -168,8 +189,26 @@ namespace graphene { namespace db {
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         /// Called by the indexes for every newly tracked change
+         void on_dirty();
+         void clear_checkpoint_tracking( const undo_values_before* values_before = nullptr );
+
+         /// Threads for loading large index files, see primary_index::load_parallel()
+         uint32_t acquire_load_threads( uint32_t wanted );
+         void release_load_threads( uint32_t count );
+
+         /// Beyond this many tracked changes the next checkpoint is written as a full flush() instead
+         static constexpr uint64_t max_tracked_changes = 1000000;
+
          fc::path                                                  _data_dir;
          std::vector< std::vector< std::unique_ptr<index> > >      _index;
+
+         uint32_t                                                  _max_checkpoint_segments = 0;
+         uint32_t                                                  _checkpoint_segments = 0;
+         bool                                                      _track_changes = false;
+         uint64_t                                                  _tracked_changes = 0;
+         /// Extra threads that the indexes may still start while open() loads them
+         std::atomic<uint32_t>                                     _spare_load_threads{0};
    };
 
 } } // graphene::db
@@ -0,0 +1,171 @@
+/*
+ * Acloudbank
+ */
+#pragma once
+#include <fc/container/flat_fwd.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/reflect/typename.hpp>
+#include <fc/safe.hpp>
+#include <fc/static_variant.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   namespace detail {
+
+      /**
+       *  Collects a textual description of the serialized layout of a type: the names and, recursively, the
+       *  layouts of the members of reflected types and of the elements of the common containers.  Other types
+       *  are described by their fc::get_typename() name only, which unlike typeid(T).name() is the same with
+       *  every compiler.
+       */
+      struct schema_builder
+      {
+         std::string                description;
+         std::set<std::type_index>  in_progress; ///< stops the recursion on self-referencing types
+      };
+
+      template<typename T, typename = void>
+      struct has_typename : std::false_type {};
+      template<typename T>
+      struct has_typename< T, decltype( (void)fc::get_typename<T>::name() ) > : std::true_type {};
+
+      template<typename T>
+      void describe_name( schema_builder& b, std::true_type )
+      {
+         b.description += fc::get_typename<T>::name();
+      }
+      /// Types without a name in fc are plain values or serialize themselves, e.g. keys, their size is portable
+      template<typename T>
+      void describe_name( schema_builder& b, std::false_type )
+      {
+         b.description += "unnamed";
+         b.description += std::to_string( sizeof(T) );
+      }
+      template<typename T>
+      void describe_name( schema_builder& b )
+      {
+         describe_name<T>( b, has_typename<T>() );
+      }
+
+      template<typename T, bool Reflected = fc::reflector<T>::is_defined::value && !std::is_enum<T>::value>
+      struct schema_of
+      {
+         static void describe( schema_builder& b )
+         {
+            describe_name<T>( b );
+            b.description += ';';
+         }
+      };
+
+      template<typename Class>
+      struct schema_member_visitor
+      {
+         schema_builder& b;
+
+         template<typename Member, class Type, Member (Type::*member)>
+         void operator()( const char* name )const
+         {
+            b.description += name;
+            b.description += ':';
+            schema_of<Member>::describe( b );
+         }
+      };
+
+      template<typename T>
+      struct schema_of<T, true>
+      {
+         static void describe( schema_builder& b )
+         {
+            describe_name<T>( b );
+            if( !b.in_progress.insert( std::type_index( typeid(T) ) ).second )
+            {
+               b.description += ';';
+               return;
+            }
+            b.description += '{';
+            fc::reflector<T>::visit( schema_member_visitor<T>{ b } );
+            b.description += '}';
+            b.in_progress.erase( std::type_index( typeid(T) ) );
+         }
+      };
+
+      template<typename... Ts>
+      struct schema_of_all
+      {
+         static void describe( schema_builder& b )
+         {
+            // expands to one call per type, in order
+            int dummy[] = { 0, ( schema_of<Ts>::describe( b ), 0 )... };
+            (void)dummy;
+         }
+      };
+
+      template<typename... Ts>
+      struct schema_of_container
+      {
+         static void describe( schema_builder& b, const char* kind )
+         {
+            b.description += kind;
+            b.description += '<';
+            schema_of_all<Ts...>::describe( b );
+            b.description += '>';
+         }
+      };
+
+      template<typename T, typename... A>
+      struct schema_of< std::vector<T, A...>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<T>::describe( b, "vector" ); } };
+      template<typename T, typename... A>
+      struct schema_of< std::set<T, A...>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<T>::describe( b, "set" ); } };
+      template<typename K, typename V, typename... A>
+      struct schema_of< std::map<K, V, A...>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<K, V>::describe( b, "map" ); } };
+      template<typename T, typename... A>
+      struct schema_of< boost::container::flat_set<T, A...>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<T>::describe( b, "flat_set" ); } };
+      template<typename K, typename V, typename... A>
+      struct schema_of< boost::container::flat_map<K, V, A...>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<K, V>::describe( b, "flat_map" ); } };
+      template<typename A, typename B>
+      struct schema_of< std::pair<A, B>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<A, B>::describe( b, "pair" ); } };
+      template<typename T>
+      struct schema_of< fc::optional<T>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<T>::describe( b, "optional" ); } };
+      template<typename T>
+      struct schema_of< fc::safe<T>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<T>::describe( b, "safe" ); } };
+      template<typename... Ts>
+      struct schema_of< fc::static_variant<Ts...>, false >
+      { static void describe( schema_builder& b ) { schema_of_container<Ts...>::describe( b, "static_variant" ); } };
+
+   } // detail
+
+   /**
+    *  @return a hash of the serialized layout of @p T, derived from its reflection.  Changes whenever a member is
+    *  added, removed, renamed, reordered or changes its type, also in nested reflected types.
+    */
+   template<typename T>
+   fc::sha256 object_schema_hash()
+   {
+      static const fc::sha256 hash = []() {
+         detail::schema_builder b;
+         detail::schema_of<T>::describe( b );
+         return fc::sha256::hash( b.description );
+      }();
+      return hash;
+   }
+
+} } // graphene::db
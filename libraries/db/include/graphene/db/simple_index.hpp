@@ -113,6 +113,9 @@ namespace graphene { namespace db {
          const_iterator end()const   { return const_iterator(_objects, _objects.end());   }
 
          size_t size()const { return _objects.size(); }
+
+         /** Called before loading @p count objects */
+         void reserve( size_t count ) { _objects.reserve( count ); }
       private:
          std::vector< std::unique_ptr<object> > _objects;
    };
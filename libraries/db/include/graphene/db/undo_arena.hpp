@@ -0,0 +1,113 @@
+/*
+ * Acloudbank
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   class object;
+
+   /**
+    * @class undo_arena_pool
+    * @brief Recycles fixed-size memory blocks between undo arenas
+    *
+    * Undo states are created and destroyed for every pending transaction, so rather than returning the blocks
+    * of a released arena to the heap they are kept here for the next session.  Not thread safe, the pool is
+    * owned by an @ref undo_database and only touched from the thread that modifies the database.
+    */
+   class undo_arena_pool
+   {
+      public:
+         static constexpr size_t block_size       = 64 * 1024;
+         static constexpr size_t max_spare_blocks = 256;
+
+         undo_arena_pool() = default;
+         undo_arena_pool( const undo_arena_pool& ) = delete;
+         undo_arena_pool& operator=( const undo_arena_pool& ) = delete;
+         ~undo_arena_pool();
+
+         /** @return a block of @ref block_size bytes, reused if possible */
+         char* acquire();
+         /** Gives back a block obtained from @ref acquire */
+         void  recycle( char* block );
+
+         /** @return number of blocks that had to be taken from the heap so far */
+         uint64_t blocks_allocated()const { return _blocks_allocated; }
+
+      private:
+         std::vector<char*> _spare;
+         uint64_t           _blocks_allocated = 0;
+   };
+
+   /**
+    * @class undo_arena
+    * @brief Bump allocator holding the object copies of one undo state
+    *
+    * Objects are copy-constructed into the arena and stay there until the arena is released, which destroys all
+    * of them and hands the memory back to the pool in one go.  Individual objects are never freed.
+    */
+   class undo_arena
+   {
+      public:
+         undo_arena() = default;
+         explicit undo_arena( undo_arena_pool& pool ) : _pool( &pool ) {}
+         undo_arena( const undo_arena& ) = delete;
+         undo_arena& operator=( const undo_arena& ) = delete;
+         ~undo_arena() { release(); }
+
+         /** Copy-constructs @p src into the arena, the copy is destroyed by @ref release */
+         template<typename T>
+         T* construct( const T& src )
+         {
+            static_assert( alignof(T) <= alignof(std::max_align_t), "Over-aligned objects are not supported" );
+            auto* record = static_cast<object_record*>( allocate( sizeof(object_record), alignof(object_record) ) );
+            void* mem = allocate( sizeof(T), alignof(T) );
+            T* result = new( mem ) T( src );
+            record->obj = result;
+            record->prev = _last_record;
+            if( _first_record == nullptr )
+               _first_record = record;
+            _last_record = record;
+            return result;
+         }
+
+         /** @return uninitialized raw storage of @p size bytes */
+         char* allocate_bytes( size_t size ) { return static_cast<char*>( allocate( size, 1 ) ); }
+
+         /** Takes over all blocks and objects of @p other, leaving it empty */
+         void absorb( undo_arena& other );
+
+         /** Destroys all objects and returns the memory */
+         void release();
+
+         bool empty()const { return _head == nullptr; }
+         /** @return true if the arena uses more than one block of memory */
+         bool multiple_blocks()const { return _head != nullptr && _head->prev != nullptr; }
+
+      private:
+         struct block_header
+         {
+            block_header* prev;
+            size_t        size;
+         };
+         struct object_record
+         {
+            object*        obj;
+            object_record* prev;
+         };
+
+         void* allocate( size_t size, size_t align );
+         void  free_block( block_header* block );
+
+         undo_arena_pool* _pool         = nullptr;
+         block_header*    _head         = nullptr; ///< block currently used for allocation, older ones via prev
+         size_t           _used         = 0;       ///< bytes used in _head, including its header
+         object_record*   _first_record = nullptr;
+         object_record*   _last_record  = nullptr;
+   };
+
+} } // graphene::db
@@ -3,17 +3,56 @@
 #include <graphene/db/object.hpp>
 #include <deque>
 #include <fc/exception/exception.hpp>
+#include <fc/container/flat.hpp>
+#include <fc/optional.hpp>
 
 namespace graphene { namespace db {
 
    class object_database;
 
+   /**
+    * Pre-modification value of an object stored relative to its serialized current value.
+    * Either the complete serialized pre-image, or a list of patches each consisting of a 32 bit offset,
+    * a 32 bit length and the original bytes at that position.
+    */
+   struct undo_delta
+   {
+      const char* data = nullptr;
+      uint32_t    size = 0;
+      bool        full = false;
+   };
+
+   /**
+    * Changes recorded within one undo session.  Copies of modified and removed objects live in @ref arena,
+    * which releases all of them at once when the state is discarded.
+    *
+    * When the session is committed, modified objects of indexes using delta undo are moved from
+    * @ref old_values to @ref old_deltas.
+    */
    struct undo_state
    {
-      std::unordered_map<object_id_type, std::unique_ptr<object> > old_values;
-      std::unordered_map<object_id_type, object_id_type>           old_index_next_ids;
-      std::unordered_set<object_id_type>                           new_ids;
-      std::unordered_map<object_id_type, std::unique_ptr<object> > removed;
+      undo_state() = default;
+      explicit undo_state( undo_arena_pool& pool ) : arena( pool ) {}
+
+      fc::flat_map<object_id_type, object*>         old_values;
+      fc::flat_map<object_id_type, undo_delta>      old_deltas;
+      fc::flat_map<object_id_type, object_id_type>  old_index_next_ids;
+      fc::flat_set<object_id_type>                  new_ids;
+      fc::flat_map<object_id_type, object*>         removed;
+      undo_arena                                    arena;
+   };
+
+   /**
+    * Serialized values the objects changed within some undo states had before these states, i.e. what has to be
+    * written instead of the current values to save the state as of an earlier block, see
+    * undo_database::get_values_before()
+    */
+   struct undo_values_before
+   {
+      /// Objects that did not exist yet map to an empty optional
+      fc::flat_map<object_id_type, fc::optional<std::vector<char>>>  objects;
+      /// Next IDs of the indexes that created objects, by space and type with instance 0
+      fc::flat_map<object_id_type, object_id_type>                   next_ids;
    };
 
 
@@ -102,16 +141,38 @@ namespace graphene { namespace db {
 
          const undo_state& head()const;
 
+         /**
+          * Collects the values the objects changed by the newest @p states committed undo states had before these
+          * states, without reverting anything.  Must not be called while sessions are active.
+          */
+         undo_values_before get_values_before( size_t states )const;
+
       private:
          void undo();
          void merge();
          void commit();
 
+         /** Reverts the database to the state before @p state was recorded */
+         void revert( undo_state& state );
+         /**
+          *  Replaces modified objects of delta undo indexes in @p state by deltas against their current value, if
+          *  that frees a good part of the memory of @p state
+          */
+         void compact( undo_state& state );
+         /** @return a copy of the pre-image described by @p delta, given the current value of the object */
+         object* restore( undo_state& state, const object& current, const undo_delta& delta );
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
+         undo_arena_pool         _arena_pool;
          std::deque<undo_state>  _stack;
          object_database&        _db;
          size_t                  _max_size = 256;
+
+         /// scratch space reused by merge()
+         std::vector< std::pair<object_id_type, object*> > _merge_buffer;
+         /// scratch space reused by compact()
+         std::vector<char>                                  _delta_buffer;
    };
 
 } } // graphene::db
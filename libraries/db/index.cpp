@@ -7,17 +7,30 @@
 
 namespace graphene { namespace db {
    void base_primary_index::save_undo( const object& obj )
-   { _db.save_undo( obj ); }
+   { _db.save_undo( obj ); mark_dirty( obj ); }
 
    void base_primary_index::on_add( const object& obj )
    {
       _db.save_undo_add( obj );
+      mark_dirty( obj );
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   { _db.save_undo_remove( obj ); mark_dirty( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
 
    void base_primary_index::on_modify( const object& obj )
    {for( auto ob : _observers ) ob->on_modify(  obj ); }
+
+   uint32_t base_primary_index::acquire_load_threads( uint32_t wanted )
+   { return _db.acquire_load_threads( wanted ); }
+
+   void base_primary_index::release_load_threads( uint32_t count )
+   { _db.release_load_threads( count ); }
+
+   void base_primary_index::mark_dirty( const object& obj )
+   {
+      if( _db._track_changes && _dirty.insert( obj.id ).second )
+         _db.on_dirty();
+   }
 } } // graphene::chain
@@ -7,8 +7,32 @@
 #include <fc/container/flat.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace graphene { namespace db {
 
+namespace {
+   /// Waits until the contents of the file or directory @p p are on disk, a rename is durable once its directory is
+   void sync_to_disk( const fc::path& p )
+   {
+#ifndef _WIN32
+      const int fd = ::open( p.generic_string().c_str(), O_RDONLY );
+      FC_ASSERT( fd >= 0, "Failed to open ${p}", ("p",p) );
+      const int result = ::fsync( fd );
+      ::close( fd );
+      FC_ASSERT( result == 0, "Failed to sync ${p}", ("p",p) );
+#endif
+   }
+}
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -58,7 +82,7 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
-void object_database::flush()
+void object_database::flush( const undo_values_before* values_before )
 {
    const auto tmp_dir = _data_dir / "object_database.tmp";
    const auto old_dir = _data_dir / "object_database.old";
@@ -73,8 +97,8 @@ void object_database::flush()
 
    auto push_task = [this,&tasks,&tmp_dir]( size_t space, size_t type ) {
       if( _index[space][type] )
-         tasks.push_back( fc::do_parallel( [this,space,type,&tmp_dir] () {
-            _index[space][type]->save( tmp_dir / fc::to_string(space) / fc::to_string(type) );
+         tasks.push_back( fc::do_parallel( [this,space,type,&tmp_dir,values_before] () {
+            _index[space][type]->save( tmp_dir / fc::to_string(space) / fc::to_string(type), values_before );
          } ) );
    };
 
@@ -97,6 +121,95 @@ void object_database::flush()
    }
    fc::rename( tmp_dir, target_dir );
    fc::remove_all( old_dir );
+
+   // the new files contain all changes, and the checkpoint segments have been replaced along with the old files
+   clear_checkpoint_tracking( values_before );
+   _checkpoint_segments = 0;
+   _track_changes = checkpoints_enabled();
+}
+
+void object_database::enable_checkpoints( uint32_t max_segments )
+{
+   _max_checkpoint_segments = max_segments;
+   // if the database has been opened already, untracked changes may exist and the first checkpoint must flush
+   _track_changes = checkpoints_enabled() && _data_dir.empty();
+   if( !_track_changes )
+      clear_checkpoint_tracking();
+}
+
+void object_database::checkpoint( const undo_values_before* values_before )
+{ try {
+   if( !checkpoints_enabled() )
+      return;
+   if( !_track_changes || _checkpoint_segments >= _max_checkpoint_segments )
+   {
+      flush( values_before );
+      return;
+   }
+
+   const auto segments_dir = _data_dir / "object_database" / "checkpoints";
+   const auto tmp_dir = segments_dir / "tmp";
+   try {
+      if( fc::exists( tmp_dir ) )
+         fc::remove_all( tmp_dir );
+      fc::create_directories( tmp_dir );
+      const auto spaces = _index.size();
+      for( size_t space = 0; space < spaces; ++space )
+      {
+         const auto types = _index[space].size();
+         for( size_t type = 0; type < types; ++type )
+         {
+            const auto file = tmp_dir / ( fc::to_string(space) + "." + fc::to_string(type) );
+            if( _index[space][type] && _index[space][type]->save_delta( file, values_before ) )
+               sync_to_disk( file );
+         }
+      }
+      // the segment must be complete on disk before it becomes visible, and the rename must be on disk before the
+      // changes it contains are forgotten
+      sync_to_disk( tmp_dir );
+      fc::rename( tmp_dir, segments_dir / fc::to_string( _checkpoint_segments ) );
+      sync_to_disk( segments_dir );
+   } catch( ... ) {
+      // some of the tracked changes may be lost, fall back to a full flush next time
+      _track_changes = false;
+      clear_checkpoint_tracking();
+      throw;
+   }
+   ++_checkpoint_segments;
+   _tracked_changes = values_before != nullptr ? values_before->objects.size() : 0;
+} FC_CAPTURE_AND_RETHROW() }
+
+void object_database::on_dirty()
+{
+   if( ++_tracked_changes > max_tracked_changes )
+   {
+      // e.g. during a replay, writing everything is cheaper than keeping track of it
+      _track_changes = false;
+      clear_checkpoint_tracking();
+   }
+}
+
+void object_database::clear_checkpoint_tracking( const undo_values_before* values_before )
+{
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            idx->clear_delta( values_before );
+   _tracked_changes = values_before != nullptr ? values_before->objects.size() : 0;
+}
+
+uint32_t object_database::acquire_load_threads( uint32_t wanted )
+{
+   uint32_t spare = _spare_load_threads.load();
+   uint32_t granted = std::min( spare, wanted );
+   while( granted > 0 && !_spare_load_threads.compare_exchange_weak( spare, spare - granted ) )
+      granted = std::min( spare, wanted );
+   return granted;
+}
+
+void object_database::release_load_threads( uint32_t count )
+{
+   _spare_load_threads += count;
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -113,28 +226,84 @@ void object_database::open(const fc::path& data_dir)
    if( fc::exists( _data_dir / "object_database" / "lock" ) )
    {
        wlog("Ignoring locked object_database");
+       _track_changes = false;
        return;
    }
-   std::vector<fc::future<void>> tasks;
-   tasks.reserve(200);
-
-   auto push_task = [this,&tasks]( size_t space, size_t type ) {
-      if( _index[space][type] )
-         tasks.push_back( fc::do_parallel( [this,space,type] () {
-            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space) / fc::to_string(type) );
-         } ) );
+   const auto spaces = _index.size();
+   // runs f for each index in parallel, waits for all of them and rethrows the first failure
+   auto for_each_index = [this,spaces]( const std::function<void( index&, const fc::path& )>& f ) {
+      std::vector<fc::future<void>> tasks;
+      tasks.reserve(200);
+      for( size_t space = 0; space < spaces; ++space )
+      {
+         const auto types = _index[space].size();
+         for( size_t type = 0; type  < types; ++type )
+            if( _index[space][type] )
+               tasks.push_back( fc::do_parallel( [this,space,type,&f] () {
+                  f( *_index[space][type], _data_dir / "object_database" / fc::to_string(space) / fc::to_string(type) );
+               } ) );
+      }
+      std::exception_ptr error;
+      for( auto& task : tasks )
+      {
+         try {
+            task.wait();
+         } catch( ... ) {
+            if( !error )
+               error = std::current_exception();
+         }
+      }
+      if( error )
+         std::rethrow_exception( error );
    };
 
    ilog("Opening object database from ${d} ...", ("d", data_dir));
-   const auto spaces = _index.size();
-   for( size_t space = 0; space < spaces; ++space )
-   {
-      const auto types = _index[space].size();
-      for( size_t type = 0; type  < types; ++type )
-         push_task( space, type );
+   // the indexes are opened in the thread pool, large ones share this many extra threads on top of it
+   _spare_load_threads = std::max( 1u, std::thread::hardware_concurrency() );
+   const auto segments_dir = _data_dir / "object_database" / "checkpoints";
+   try {
+      // the files are checked while they are loaded
+      for_each_index( []( index& idx, const fc::path& file ) { idx.open( file ); } );
+
+      // apply the checkpoint segments written since the last flush, in order
+      _checkpoint_segments = 0;
+      while( fc::exists( segments_dir / fc::to_string( _checkpoint_segments ) ) )
+      {
+         const auto segment_dir = segments_dir / fc::to_string( _checkpoint_segments );
+         try {
+            for( size_t space = 0; space < spaces; ++space )
+            {
+               const auto types = _index[space].size();
+               for( size_t type = 0; type < types; ++type )
+               {
+                  const auto file = segment_dir / ( fc::to_string(space) + "." + fc::to_string(type) );
+                  if( _index[space][type] && fc::exists( file ) )
+                     _index[space][type]->open_delta( file );
+               }
+            }
+         } catch( const db_exception& ) {
+            throw;
+         } catch( const fc::exception& e ) {
+            // e.g. a file that cannot be mapped, the caller rebuilds the object database on a db_exception
+            FC_THROW_EXCEPTION( corrupted_index_file_exception, "Failed to apply checkpoint segment ${s}: ${e}",
+                                ("s",segment_dir)("e",e.to_detail_string()) );
+         } catch( const std::exception& e ) {
+            FC_THROW_EXCEPTION( corrupted_index_file_exception, "Failed to apply checkpoint segment ${s}: ${e}",
+                                ("s",segment_dir)("e",e.what()) );
+         }
+         ++_checkpoint_segments;
+      }
+   } catch( ... ) {
+      // drop whatever has been loaded, so that the caller can still decide to start from scratch
+      for( auto& space : _index )
+         for( auto& idx : space )
+            if( idx )
+               idx->unload();
+      _checkpoint_segments = 0;
+      throw;
    }
-   for( auto& task : tasks )
-      task.wait();
+   if( _checkpoint_segments > 0 )
+      ilog( "Applied ${n} checkpoint segments", ("n",_checkpoint_segments) );
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
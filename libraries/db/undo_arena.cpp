@@ -0,0 +1,121 @@
+/*
+ * Acloudbank
+ */
+#include <graphene/db/undo_arena.hpp>
+#include <graphene/db/object.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace db {
+
+undo_arena_pool::~undo_arena_pool()
+{
+   for( char* block : _spare )
+      delete[] block;
+}
+
+char* undo_arena_pool::acquire()
+{
+   if( _spare.empty() )
+   {
+      ++_blocks_allocated;
+      return new char[block_size];
+   }
+   char* result = _spare.back();
+   _spare.pop_back();
+   return result;
+}
+
+void undo_arena_pool::recycle( char* block )
+{
+   if( _spare.size() >= max_spare_blocks )
+      delete[] block;
+   else
+      _spare.push_back( block );
+}
+
+void* undo_arena::allocate( size_t size, size_t align )
+{
+   size_t offset = ( _used + align - 1 ) & ~( align - 1 );
+   if( _head == nullptr || offset + size > _head->size )
+   {
+      const size_t needed = sizeof(block_header) + size + align;
+      char* mem;
+      size_t block_size;
+      if( _pool != nullptr && needed <= undo_arena_pool::block_size )
+      {
+         mem = _pool->acquire();
+         block_size = undo_arena_pool::block_size;
+      }
+      else
+      {
+         block_size = std::max( needed, undo_arena_pool::block_size );
+         mem = new char[block_size];
+      }
+      auto* block = reinterpret_cast<block_header*>( mem );
+      block->prev = _head;
+      block->size = block_size;
+      _head = block;
+      offset = ( sizeof(block_header) + align - 1 ) & ~( align - 1 );
+   }
+   _used = offset + size;
+   return reinterpret_cast<char*>( _head ) + offset;
+}
+
+void undo_arena::free_block( block_header* block )
+{
+   char* mem = reinterpret_cast<char*>( block );
+   if( _pool != nullptr && block->size == undo_arena_pool::block_size )
+      _pool->recycle( mem );
+   else
+      delete[] mem;
+}
+
+void undo_arena::absorb( undo_arena& other )
+{
+   if( this == &other || other._head == nullptr )
+      return;
+   if( _head == nullptr )
+   {
+      _head = other._head;
+      _used = other._used;
+   }
+   else
+   {
+      // Other's blocks are treated as full, keep allocating from our current block
+      block_header* oldest = other._head;
+      while( oldest->prev != nullptr )
+         oldest = oldest->prev;
+      oldest->prev = _head->prev;
+      _head->prev = other._head;
+   }
+   if( other._first_record != nullptr )
+   {
+      other._first_record->prev = _last_record;
+      if( _first_record == nullptr )
+         _first_record = other._first_record;
+      _last_record = other._last_record;
+   }
+   other._head = nullptr;
+   other._used = 0;
+   other._first_record = nullptr;
+   other._last_record = nullptr;
+}
+
+void undo_arena::release()
+{
+   for( object_record* record = _last_record; record != nullptr; record = record->prev )
+      record->obj->~object();
+   _first_record = nullptr;
+   _last_record = nullptr;
+
+   while( _head != nullptr )
+   {
+      block_header* prev = _head->prev;
+      free_block( _head );
+      _head = prev;
+   }
+   _used = 0;
+}
+
+} } // graphene::db
@@ -3,8 +3,84 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <cstring>
+
 namespace graphene { namespace db {
 
+namespace {
+
+   constexpr size_t delta_patch_header_size = 2 * sizeof(uint32_t);
+
+   void append_patch( std::vector<char>& out, const std::vector<char>& before, size_t offset, size_t length )
+   {
+      const uint32_t header[2] = { static_cast<uint32_t>(offset), static_cast<uint32_t>(length) };
+      const char* h = reinterpret_cast<const char*>( header );
+      out.insert( out.end(), h, h + delta_patch_header_size );
+      out.insert( out.end(), before.begin() + offset, before.begin() + offset + length );
+   }
+
+   /// Encodes @p before relative to @p after, using @p buffer as scratch space
+   undo_delta make_delta( undo_arena& arena, const std::vector<char>& before, const std::vector<char>& after,
+                          std::vector<char>& buffer )
+   {
+      undo_delta result;
+      buffer.clear();
+      if( before.size() == after.size() )
+      {
+         const size_t n = before.size();
+         size_t i = 0;
+         while( i < n && buffer.size() < n )
+         {
+            if( before[i] == after[i] )
+            {
+               ++i;
+               continue;
+            }
+            // extend the patch over short runs of equal bytes, a new patch header would cost more
+            size_t last_diff = i;
+            for( size_t j = i + 1; j < n && j - last_diff <= delta_patch_header_size; ++j )
+               if( before[j] != after[j] )
+                  last_diff = j;
+            append_patch( buffer, before, i, last_diff - i + 1 );
+            i = last_diff + 1;
+         }
+      }
+      const std::vector<char>& encoded = ( before.size() == after.size() && buffer.size() < before.size() )
+                                         ? buffer : before;
+      result.full = ( &encoded == &before );
+      result.size = static_cast<uint32_t>( encoded.size() );
+      if( result.size > 0 )
+      {
+         char* data = arena.allocate_bytes( result.size );
+         std::memcpy( data, encoded.data(), result.size );
+         result.data = data;
+      }
+      return result;
+   }
+
+   /// Turns the serialized current value in @p bytes into the serialized pre-image
+   void apply_delta( std::vector<char>& bytes, const undo_delta& delta )
+   {
+      if( delta.full )
+      {
+         bytes.assign( delta.data, delta.data + delta.size );
+         return;
+      }
+      size_t pos = 0;
+      while( pos < delta.size )
+      {
+         uint32_t header[2];
+         std::memcpy( header, delta.data + pos, delta_patch_header_size );
+         pos += delta_patch_header_size;
+         FC_ASSERT( size_t(header[0]) + header[1] <= bytes.size() && pos + header[1] <= delta.size,
+                    "Corrupted undo delta" );
+         std::memcpy( bytes.data() + header[0], delta.data + pos, header[1] );
+         pos += header[1];
+      }
+   }
+
+} // anonymous namespace
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -31,7 +107,7 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
    while( size() > max_size() )
       _stack.pop_front();
 
-   _stack.emplace_back();
+   _stack.emplace_back( _arena_pool );
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
@@ -40,7 +116,7 @@ void undo_database::on_create( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      _stack.emplace_back( _arena_pool );
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
@@ -53,48 +129,120 @@ void undo_database::on_modify( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      _stack.emplace_back( _arena_pool );
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
-   auto itr =  state.old_values.find(obj.id);
-   if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   auto itr = state.old_values.lower_bound(obj.id);
+   if( itr != state.old_values.end() && itr->first == obj.id ) return;
+   // the delta is relative to the current value, which is about to change
+   auto ditr = state.old_deltas.find(obj.id);
+   if( ditr != state.old_deltas.end() )
+   {
+      state.old_values.emplace_hint( itr, obj.id, restore( state, obj, ditr->second ) );
+      state.old_deltas.erase(ditr);
+      return;
+   }
+   state.old_values.emplace_hint( itr, obj.id, obj.clone_into( state.arena ) );
 }
 void undo_database::on_remove( const object& obj )
 {
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      _stack.emplace_back( _arena_pool );
    undo_state& state = _stack.back();
-   if( state.new_ids.count(obj.id) > 0 )
+   if( state.new_ids.erase(obj.id) > 0 )
+      return;
+   auto itr = state.old_values.find(obj.id);
+   if( itr != state.old_values.end() )
    {
-      state.new_ids.erase(obj.id);
+      state.removed[obj.id] = itr->second;
+      state.old_values.erase(itr);
       return;
    }
-   if( state.old_values.count(obj.id) > 0 )
+   auto ditr = state.old_deltas.find(obj.id);
+   if( ditr != state.old_deltas.end() )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
-      state.old_values.erase(obj.id);
+      state.removed[obj.id] = restore( state, obj, ditr->second );
+      state.old_deltas.erase(ditr);
       return;
    }
    if( state.removed.count(obj.id) > 0 ) return;
-   state.removed[obj.id] = obj.clone();
+   state.removed[obj.id] = obj.clone_into( state.arena );
 }
 
-void undo_database::undo()
-{ try {
-   FC_ASSERT( !_disabled );
-   FC_ASSERT( _active_sessions > 0 );
-   disable();
+object* undo_database::restore( undo_state& state, const object& current, const undo_delta& delta )
+{
+   object* result = current.clone_into( state.arena );
+   auto bytes = current.pack();
+   apply_delta( bytes, delta );
+   _db.get_index( current.id.space(), current.id.type() ).object_from_packed( bytes, *result );
+   return result;
+}
 
-   auto& state = _stack.back();
+void undo_database::compact( undo_state& state )
+{
+   // Copies cannot be freed individually, so everything that stays is moved over to a fresh arena.  That is only
+   // worth it if the state spans several blocks and at least half of its copies become deltas, a state whose only
+   // candidates are e.g. the dynamic global properties keeps its copies.
+   if( !state.arena.multiple_blocks() )
+      return;
+   size_t candidates = 0;
+   for( const auto& item : state.old_values )
+      if( _db.get_index( item.first.space(), item.first.type() ).uses_delta_undo()
+            && _db.find_object( item.first ) != nullptr )
+         ++candidates;
+   if( candidates == 0 || candidates * 2 < state.old_values.size() + state.removed.size() )
+      return;
+
+   undo_arena arena( _arena_pool );
+   for( auto& item : state.old_deltas )
+   {
+      if( item.second.size == 0 )
+         continue;
+      char* data = arena.allocate_bytes( item.second.size );
+      std::memcpy( data, item.second.data, item.second.size );
+      item.second.data = data;
+   }
+   fc::flat_map<object_id_type, object*> kept;
+   kept.reserve( state.old_values.size() );
+   for( const auto& item : state.old_values )
+   {
+      if( _db.get_index( item.first.space(), item.first.type() ).uses_delta_undo() )
+      {
+         const object* current = _db.find_object( item.first );
+         if( current != nullptr )
+         {
+            state.old_deltas[item.first] = make_delta( arena, item.second->pack(), current->pack(), _delta_buffer );
+            continue;
+         }
+      }
+      kept.emplace_hint( kept.end(), item.first, item.second->clone_into( arena ) );
+   }
+   for( auto& item : state.removed )
+      item.second = item.second->clone_into( arena );
+   state.old_values = std::move( kept );
+   state.arena.release();
+   state.arena.absorb( arena );
+}
+
+void undo_database::revert( undo_state& state )
+{
    for( auto& item : state.old_values )
    {
       _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
    }
 
+   for( auto& item : state.old_deltas )
+   {
+      const object& current = _db.get_object( item.first );
+      auto bytes = current.pack();
+      apply_delta( bytes, item.second );
+      const index& idx = _db.get_index( item.first.space(), item.first.type() );
+      _db.modify( current, [&]( object& obj ){ idx.object_from_packed( bytes, obj ); } );
+   }
+
    for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
    {
       _db.remove( _db.get_object(*ritr) );
@@ -107,6 +255,15 @@ void undo_database::undo()
 
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
+}
+
+void undo_database::undo()
+{ try {
+   FC_ASSERT( !_disabled );
+   FC_ASSERT( _active_sessions > 0 );
+   disable();
+
+   revert( _stack.back() );
 
    _stack.pop_back();
    enable();
@@ -168,28 +325,41 @@ void undo_database::merge()
 
    // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
 
+   // Type B entries are collected first and then bulk-inserted, the flat containers would otherwise move their
+   // tail on every single insertion.  Iterating the sorted containers of B keeps the collected entries sorted.
+   auto& moved = _merge_buffer;
+
    // *+upd
+   moved.clear();
    for( auto& obj : state.old_values )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
       {
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.old_values.find(obj.first) != prev_state.old_values.end() )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
+      auto dit = prev_state.old_deltas.find(obj.first);
+      if( dit != prev_state.old_deltas.end() )
+      {
+         // same as above, but X is encoded relative to Y, which the merged changes no longer are at
+         prev_state.old_values[obj.first] = restore( prev_state, *obj.second, dit->second );
+         prev_state.old_deltas.erase(dit);
+         continue;
+      }
       // del+upd -> N/A
-      assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
+      assert( prev_state.removed.find(obj.first) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      moved.emplace_back( obj.first, obj.second );
    }
+   prev_state.old_values.insert( boost::container::ordered_unique_range, moved.begin(), moved.end() );
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
-   for( auto id : state.new_ids )
-      prev_state.new_ids.insert(id);
+   prev_state.new_ids.insert( boost::container::ordered_unique_range, state.new_ids.begin(), state.new_ids.end() );
 
    // old_index_next_ids can only be updated, iterate over *+upd cases
    for( auto& item : state.old_index_next_ids )
@@ -209,27 +379,40 @@ void undo_database::merge()
    }
 
    // *+del
+   moved.clear();
    for( auto& obj : state.removed )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.erase(obj.first) > 0 )
       {
          // new + del -> nop (type C)
-         prev_state.new_ids.erase(obj.second->id);
          continue;
       }
-      auto it = prev_state.old_values.find(obj.second->id);
+      auto it = prev_state.old_values.find(obj.first);
       if( it != prev_state.old_values.end() )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         prev_state.removed[obj.first] = it->second;
+         prev_state.old_values.erase(it);
+         continue;
+      }
+      auto dit = prev_state.old_deltas.find(obj.first);
+      if( dit != prev_state.old_deltas.end() )
+      {
+         // same as above, X is encoded relative to Y
+         prev_state.removed[obj.first] = restore( prev_state, *obj.second, dit->second );
+         prev_state.old_deltas.erase(dit);
          continue;
       }
       // del + del -> N/A
-      assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
+      assert( prev_state.removed.find( obj.first ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
-      prev_state.removed[obj.second->id] = std::move(obj.second);
+      moved.emplace_back( obj.first, obj.second );
    }
+   prev_state.removed.insert( boost::container::ordered_unique_range, moved.begin(), moved.end() );
+   moved.clear();
+
+   // prev_state may now point to copies owned by state, keep them alive
+   prev_state.arena.absorb( state.arena );
    _stack.pop_back();
    --_active_sessions;
 }
@@ -237,6 +420,9 @@ void undo_database::commit()
 {
    FC_ASSERT( _active_sessions > 0 );
    --_active_sessions;
+   // A committed state is only needed again to pop the block, trade copies for smaller deltas where possible
+   if( !_disabled && !_stack.empty() )
+      compact( _stack.back() );
 }
 
 void undo_database::pop_commit()
@@ -246,25 +432,7 @@ void undo_database::pop_commit()
 
    disable();
    try {
-      auto& state = _stack.back();
-
-      for( auto& item : state.old_values )
-      {
-         _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
-      }
-
-      for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
-      {
-         _db.remove( _db.get_object(*ritr) );
-      }
-
-      for( auto& item : state.old_index_next_ids )
-      {
-         _db.get_mutable_index( item.first.space(), item.first.type() ).set_next_id( item.second );
-      }
-
-      for( auto& item : state.removed )
-         _db.insert( std::move(*item.second) );
+      revert( _stack.back() );
 
       _stack.pop_back();
    }
@@ -282,4 +450,32 @@ const undo_state& undo_database::head()const
    return _stack.back();
 }
 
+undo_values_before undo_database::get_values_before( size_t states )const
+{ try {
+   FC_ASSERT( _active_sessions == 0 );
+   FC_ASSERT( states <= _stack.size() );
+   undo_values_before result;
+   // older states overwrite what newer ones recorded, so the oldest pre-image of every object wins
+   for( auto state = _stack.rbegin(); state != _stack.rbegin() + states; ++state )
+   {
+      for( const auto& id : state->new_ids )
+         result.objects[id].reset();
+      for( const auto& item : state->old_values )
+         result.objects[item.first] = item.second->pack();
+      for( const auto& item : state->removed )
+         result.objects[item.first] = item.second->pack();
+      for( const auto& item : state->old_deltas )
+      {
+         // the delta is relative to the value after this state, as recorded by a newer state or still current
+         auto& value = result.objects[item.first];
+         if( !value.valid() )
+            value = _db.get_object( item.first ).pack();
+         apply_delta( *value, item.second );
+      }
+      for( const auto& item : state->old_index_next_ids )
+         result.next_ids[item.first] = item.second;
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW( (states) ) }
+
 } } // graphene::db
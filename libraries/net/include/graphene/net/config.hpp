@@ -6,7 +6,13 @@
 
 #include <stddef.h>
 
-#define GRAPHENE_NET_PROTOCOL_VERSION                        106
+#define GRAPHENE_NET_PROTOCOL_VERSION                        107
+
+/**
+ * Peers with at least this protocol version are sent recently broadcast blocks as
+ * compact_block_messages instead of full block_messages
+ */
+#define GRAPHENE_NET_COMPACT_BLOCKS_PROTOCOL_VERSION         107
 
 /**
  * Define this to enable debugging code in the p2p network interface.
@@ -65,6 +71,14 @@
 
 #define GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES           2
 
+/**
+ * Which items we have advertised to a peer is remembered in a rolling Bloom filter holding this
+ * many items per generation, with roughly this false positive rate.  A false positive only means
+ * an item isn't advertised to that peer, which will hear about it from its other peers
+ */
+#define GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION   20000
+#define GRAPHENE_NET_INVENTORY_FILTER_FALSE_POSITIVE_RATE    0.0001
+
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
 /**
@@ -90,6 +104,23 @@
 
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      1000
 
+/**
+ * Transactions that come in from peers while the client is busy with earlier ones are handed
+ * to it together, at most this many at a time
+ */
+#define GRAPHENE_NET_MAX_TRX_PER_BATCH                       1000
+
+/**
+ * No more transactions are fetched from peers while this many received ones are waiting for the client
+ */
+#define GRAPHENE_NET_MAX_QUEUED_TRX                          (2 * GRAPHENE_NET_MAX_TRX_PER_BATCH)
+
+/**
+ * The client applies a batch of transactions in slices of at most this many, and lets the other tasks of its
+ * thread, like block production, run in between
+ */
+#define GRAPHENE_NET_TRX_PER_APPLY_SLICE                     50
+
 #define GRAPHENE_NET_MAX_NESTED_OBJECTS                      (250)
 
 #define MAXIMUM_PEERDB_SIZE 1000
@@ -23,6 +23,7 @@ namespace graphene { namespace net {
   using graphene::protocol::block_id_type;
   using graphene::protocol::transaction_id_type;
   using graphene::protocol::signed_block;
+  using graphene::protocol::signed_block_header;
 
   typedef fc::ecc::public_key_data node_id_t;
   typedef fc::ripemd160 item_hash_t;
@@ -65,6 +66,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_block_transactions_message_type        = 5019,
+    block_transactions_message_type              = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -94,6 +98,69 @@ namespace graphene { namespace net {
 
    };
 
+   /// A transaction of a @ref compact_block_message, which the receiver looks up by its id
+   struct compact_block_transaction
+   {
+      transaction_id_type                               id;
+      std::vector<graphene::protocol::operation_result> operation_results;
+
+      compact_block_transaction() {}
+      compact_block_transaction(const graphene::protocol::processed_transaction& trx)
+      :id(trx.id()),operation_results(trx.operation_results){}
+   };
+
+   /**
+    * A block without the bodies of its transactions, sent in reply to a request for a recently
+    * broadcast block to peers that understand it.  The receiver takes the transactions from its
+    * message cache and asks for the ones it doesn't have with a @ref fetch_block_transactions_message.
+    */
+   struct compact_block_message
+   {
+      static const core_message_type_enum type;
+
+      compact_block_message(){}
+      compact_block_message(const block_message& blk_msg )
+      :header(blk_msg.block),block_id(blk_msg.block_id)
+      {
+         transactions.reserve( blk_msg.block.transactions.size() );
+         for( const auto& trx : blk_msg.block.transactions )
+            transactions.emplace_back( trx );
+      }
+
+      signed_block_header                    header;
+      block_id_type                          block_id;
+      std::vector<compact_block_transaction> transactions;
+   };
+
+   struct fetch_block_transactions_message
+   {
+      static const core_message_type_enum type;
+
+      block_id_type         block_id;
+      std::vector<uint32_t> transaction_indexes; ///< positions of the transactions in the block, ascending
+
+      fetch_block_transactions_message() {}
+      fetch_block_transactions_message(const block_id_type& block_id, const std::vector<uint32_t>& transaction_indexes) :
+        block_id(block_id),
+        transaction_indexes(transaction_indexes)
+      {}
+   };
+
+   struct block_transactions_message
+   {
+      static const core_message_type_enum type;
+
+      block_id_type                                              block_id;
+      std::vector<uint32_t>                                      transaction_indexes;
+      std::vector<graphene::protocol::precomputable_transaction> transactions;
+
+      block_transactions_message() {}
+      block_transactions_message(const block_id_type& block_id, const std::vector<uint32_t>& transaction_indexes) :
+        block_id(block_id),
+        transaction_indexes(transaction_indexes)
+      {}
+   };
+
   struct item_ids_inventory_message
   {
     static const core_message_type_enum type;
@@ -402,6 +469,9 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_block_transactions_message_type)
+                 (block_transactions_message_type)
                  (core_message_type_last) )
 FC_REFLECT_ENUM(graphene::net::rejection_reason_code, (unspecified)
                                                  (different_chain)
@@ -423,6 +493,10 @@ FC_REFLECT_ENUM(graphene::net::firewall_check_result, (unable_to_check)
 
 FC_REFLECT_TYPENAME( graphene::net::trx_message )
 FC_REFLECT_TYPENAME( graphene::net::block_message )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_transaction )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_message )
+FC_REFLECT_TYPENAME( graphene::net::fetch_block_transactions_message )
+FC_REFLECT_TYPENAME( graphene::net::block_transactions_message )
 FC_REFLECT_TYPENAME( graphene::net::item_id )
 FC_REFLECT_TYPENAME( graphene::net::item_ids_inventory_message )
 FC_REFLECT_TYPENAME( graphene::net::blockchain_item_ids_inventory_message )
@@ -446,6 +520,10 @@ FC_REFLECT_TYPENAME( graphene::net::get_current_connections_reply_message )
 
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transaction )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::fetch_block_transactions_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_transactions_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_id )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::item_ids_inventory_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::blockchain_item_ids_inventory_message )
@@ -58,6 +58,19 @@ namespace graphene { namespace net {
          virtual bool handle_block( const graphene::net::block_message& blk_msg, bool sync_mode,
                                     std::vector<message_hash_type>& contained_transaction_msg_ids ) = 0;
 
+         /**
+          *  @brief Called when a block comes in during synchronization, before its predecessors may have been
+          *         handled
+          *
+          *  Starts the validation steps that do not depend on the state of the chain, e.g. the recovery of the
+          *  signing keys, so that they run in parallel for all the blocks waiting to be handled.  Can be called
+          *  from any thread.  The network does not access the block before the returned future is ready.
+          */
+         virtual fc::future<void> precompute_block( const graphene::net::block_message& blk_msg )const
+         {
+            return fc::future<void>( fc::promise<void>::create( true ) );
+         }
+
          /**
           *  @brief Called when a new transaction comes in from the network
           *
@@ -66,6 +79,34 @@ namespace graphene { namespace net {
           */
          virtual void handle_transaction( const graphene::net::trx_message& trx_msg ) = 0;
 
+         /**
+          *  @brief Called with the transactions that came in from the network while the previous ones were
+          *         being handled, in the order they came in
+          *
+          *  @returns for each transaction, the exception that prevents it from being broadcast on, if any
+          */
+         virtual std::vector<fc::oexception> handle_transactions(
+               const std::vector<graphene::net::trx_message>& trx_msgs )
+         {
+            std::vector<fc::oexception> results( trx_msgs.size() );
+            for( size_t i = 0; i < trx_msgs.size(); ++i )
+            {
+               try
+               {
+                  handle_transaction( trx_msgs[i] );
+               }
+               catch( const fc::canceled_exception& )
+               {
+                  throw;
+               }
+               catch( const fc::exception& e )
+               {
+                  results[i] = e;
+               }
+            }
+            return results;
+         }
+
          /**
           *  @brief Called when a new message comes in from the network other than a
           *         block or a transaction.  Currently there are no other possible
@@ -5,6 +5,7 @@
 
 #include <graphene/net/node.hpp>
 #include <graphene/net/peer_database.hpp>
+#include <graphene/net/rolling_bloom_filter.hpp>
 #include <graphene/net/message_oriented_connection.hpp>
 #include <graphene/net/config.hpp>
 
@@ -17,6 +18,7 @@
 #include <boost/multi_index/tag.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <map>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -31,7 +33,8 @@ namespace graphene { namespace net
       virtual void on_message(peer_connection* originating_peer,
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
-      virtual message get_message_for_item(const item_id& item) = 0;
+      /// @return the message of @p item, which may be shared with the send queues of other peers
+      virtual std::shared_ptr<const message> get_message_for_item(const item_id& item) = 0;
     };
 
     using peer_connection_ptr = std::shared_ptr<peer_connection>;
@@ -87,7 +90,7 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        virtual std::shared_ptr<const message> get_message(peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -95,21 +98,21 @@ namespace graphene { namespace net
         virtual ~queued_message() = default;
       };
 
-      /* when you queue up a 'real_queued_message', a full copy of the message is
-       * stored on the heap until it is sent
+      /* when you queue up a 'real_queued_message', the message is kept on the heap until
+       * it is sent.  It is immutable, so the same message can sit on the queues of many peers
        */
       struct real_queued_message : queued_message
       {
-        message        message_to_send;
-        size_t         message_send_time_field_offset;
+        std::shared_ptr<const message> message_to_send;
+        size_t                         message_send_time_field_offset;
 
-        real_queued_message(message message_to_send,
+        real_queued_message(std::shared_ptr<const message> message_to_send,
                             size_t message_send_time_field_offset = (size_t)-1) :
           message_to_send(std::move(message_to_send)),
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        std::shared_ptr<const message> get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -125,7 +128,7 @@ namespace graphene { namespace net
           item_to_send(std::move(the_item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        std::shared_ptr<const message> get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -235,12 +238,19 @@ namespace graphene { namespace net
             >
          >
       >;
+      /// Kept exactly, it tells us which peers we can fetch an item from
       timestamped_items_set_type inventory_peer_advertised_to_us;
-      timestamped_items_set_type inventory_advertised_to_peer;
+      /// Only checked to avoid advertising an item twice, so a false positive now and then is fine
+      rolling_bloom_filter inventory_advertised_to_peer { GRAPHENE_NET_INVENTORY_FILTER_ITEMS_PER_GENERATION,
+                                                          GRAPHENE_NET_INVENTORY_FILTER_FALSE_POSITIVE_RATE,
+                                                          fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES) };
 
       /// Items we've requested from this peer during normal operation.
       /// Fetch from another peer if this peer disconnects
       item_to_time_map_type items_requested_from_peer;
+      /// Blocks this peer sent us as compact_block_messages, waiting for the transactions we asked them for,
+      /// with the positions of those transactions in the block
+      std::map<item_hash_t, std::pair<signed_block, std::vector<uint32_t>>> compact_blocks_being_completed;
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -280,6 +290,9 @@ namespace graphene { namespace net
 
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       virtual void send_message( const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1 );
+      /// Queues a message that may also be queued for other peers, without copying it
+      virtual void send_message( std::shared_ptr<const message> message_to_send,
+                                 size_t message_send_time_field_offset = (size_t)-1 );
       void send_item(const item_id& item_to_send);
       void close_connection();
       void destroy_connection();
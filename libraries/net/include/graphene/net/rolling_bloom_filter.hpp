@@ -0,0 +1,56 @@
+/*
+ * AcloudBank
+ */
+#pragma once
+
+#include <graphene/net/core_messages.hpp>
+
+#include <fc/time.hpp>
+
+#include <vector>
+
+namespace graphene { namespace net {
+
+  /**
+   *  A Bloom filter of item ids that forgets old items.
+   *
+   *  Items are added to the current generation, which is replaced by an empty one when it is full or older
+   *  than the generation duration, while the one before it is still checked.  So an item is remembered for
+   *  at least one generation and at most two.  contains() never misses a remembered item, but may report
+   *  an item that was never inserted, at roughly the given false positive rate per generation.
+   */
+  class rolling_bloom_filter
+  {
+    public:
+      rolling_bloom_filter( uint32_t items_per_generation, double false_positive_rate,
+                            fc::microseconds generation_duration );
+
+      void insert( const item_id& item );
+      bool contains( const item_id& item ) const;
+
+      /// Starts a new generation if the current one is older than the generation duration
+      void expire_old_items();
+
+      /// @return roughly the number of items remembered
+      size_t size() const { return _current.item_count + _previous.item_count; }
+
+    private:
+      struct generation
+      {
+        std::vector<uint64_t> bits;
+        uint32_t              item_count = 0;
+        fc::time_point        start_time;
+      };
+
+      void start_new_generation();
+      bool generation_contains( const generation& g, uint64_t h1, uint64_t h2 ) const;
+
+      uint32_t         _items_per_generation;
+      uint32_t         _number_of_hashes;
+      uint64_t         _number_of_bits;
+      fc::microseconds _generation_duration;
+      generation       _current;
+      generation       _previous;
+  };
+
+} } // graphene::net
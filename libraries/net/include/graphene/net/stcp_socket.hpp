@@ -4,6 +4,9 @@
 #include <fc/crypto/aes.hpp>
 #include <fc/crypto/elliptic.hpp>
 
+#include <initializer_list>
+#include <utility>
+
 namespace graphene { namespace net {
 
 /**
@@ -28,6 +31,14 @@ class stcp_socket : public virtual fc::iostream
     virtual size_t   writesome( const char* buffer, size_t len );
     virtual size_t   writesome( const std::shared_ptr<const char>& buf, size_t len, size_t offset );
 
+    /**
+     *  Encrypts and writes the concatenation of @p buffers, zero padded to a multiple of 16 bytes.
+     *  The buffers are staged and encrypted in place in the write buffer of this socket, so the
+     *  caller doesn't need to gather them into one padded block first.
+     *  @return the number of bytes written, including the padding
+     */
+    size_t           write_padded( std::initializer_list<std::pair<const char*, size_t>> buffers );
+
     virtual void     flush();
     virtual void     close();
 
@@ -36,6 +47,11 @@ class stcp_socket : public virtual fc::iostream
     fc::sha512       get_shared_secret() const { return _shared_secret; }
   private:
     void do_key_exchange();
+    /// Encrypts the first @p len bytes of the write buffer in place and writes them
+    void encrypt_and_write_buffer( size_t len );
+
+    static constexpr size_t read_buffer_length = 65536;
+    static constexpr size_t write_buffer_length = 4096;
 
     fc::sha512           _shared_secret;
     fc::ecc::private_key _priv_key;
@@ -43,6 +59,9 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_encoder      _send_aes;
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
+    /// decrypted bytes in _read_buffer not yet returned by readsome()
+    size_t                _read_buffer_begin = 0;
+    size_t                _read_buffer_end = 0;
     std::shared_ptr<char> _write_buffer;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
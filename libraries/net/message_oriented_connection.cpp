@@ -156,6 +156,9 @@ namespace graphene { namespace net {
 
       try
       {
+        // reused for every message, so its data only needs reallocating when a message is larger than any
+        // received on this connection before.  The socket buffers and decrypts in bulk, so the small read
+        // of the header doesn't cost a read from the network
         message m;
         char buffer[BUFFER_SIZE];
         while( true )
@@ -271,19 +274,12 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size.value();
         if( message_to_send.size.value() > MAX_MESSAGE_SIZE )
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::vector<char> padded_message( size_with_padding );
-
-        memcpy( padded_message.data(), (const char*)&message_to_send, sizeof(message_header) );
-        memcpy( padded_message.data() + sizeof(message_header), message_to_send.data.data(),
-                message_to_send.size.value() );
-        char* padding_space = padded_message.data() + sizeof(message_header) + message_to_send.size.value();
-        memset(padding_space, 0, size_with_padding - size_of_message_and_header);
-        _sock.write( padded_message.data(), size_with_padding );
+        // the socket pads the message we send to a multiple of 16 bytes while encrypting it
+        size_t size_with_padding = _sock.write_padded( {
+              { (const char*)&message_to_send, sizeof(message_header) },
+              { message_to_send.data.data(), message_to_send.size.value() } } );
         _sock.flush();
         _bytes_sent += size_with_padding;
         _last_message_sent_time = fc::time_point::now();
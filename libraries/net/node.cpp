@@ -29,6 +29,7 @@
 #include <forward_list>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 #include <tuple>
 #include <string>
 #include <boost/tuple/tuple.hpp>
@@ -105,6 +106,12 @@ namespace graphene { namespace net { namespace detail {
    }
 
    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup ) const
+   {
+      return *get_shared_message( hash_of_message_to_lookup );
+   }
+
+   std::shared_ptr<const message> blockchain_tied_message_cache::get_shared_message(
+            const message_hash_type& hash_of_message_to_lookup ) const
    {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
@@ -113,6 +120,29 @@ namespace graphene { namespace net { namespace detail {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
    }
 
+   std::shared_ptr<const message> blockchain_tied_message_cache::find_message_by_contents_hash(
+            const message_hash_type& hash_of_msg_contents_to_lookup ) const
+   {
+      message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_contents_hash_index>().find(hash_of_msg_contents_to_lookup );
+      if( iter != _message_cache.get<message_contents_hash_index>().end() )
+         return iter->message_body;
+      return std::shared_ptr<const message>();
+   }
+
+   std::shared_ptr<const message> blockchain_tied_message_cache::get_compact_block_message(
+            const message_hash_type& hash_of_message_to_lookup ) const
+   {
+      message_cache_container::index<message_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+      if( iter == _message_cache.get<message_hash_index>().end() )
+         FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+      if( !iter->compact_block_body )
+         iter->compact_block_body = std::make_shared<const message>(
+               compact_block_message( iter->message_body->as<block_message>() ) );
+      return iter->compact_block_body;
+   }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data(
              const message_hash_type& hash_of_msg_contents_to_lookup ) const
     {
@@ -508,9 +538,9 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
       return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
+                          [&item_hash]( const received_sync_item& item ) { return item.message.block_id == item_hash; } ) != _received_sync_items.end() ||
              std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+                          [&item_hash]( const received_sync_item& item ) { return item.message.block_id == item_hash; } ) != _new_received_sync_items.end();
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -639,6 +669,8 @@ namespace graphene { namespace net { namespace detail {
         fc::time_point oldest_timestamp_to_fetch = fc::time_point::now()
               - fc::seconds(_recent_block_interval_seconds * GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS);
         fc::time_point next_peer_unblocked_time = fc::time_point::maximum();
+        // back-pressure, transactions stay in _items_to_fetch while the client has not caught up with the queue
+        const bool fetch_transactions = _received_transactions.size() < GRAPHENE_NET_MAX_QUEUED_TRX;
 
         // we need to construct a list of items to request from each peer first,
         // then send the messages (in two steps, to avoid yielding while iterating)
@@ -681,6 +713,8 @@ namespace graphene { namespace net { namespace detail {
                  ("item", item_iter->item));
             item_iter = _items_to_fetch.erase(item_iter);
           }
+          else if (item_iter->item.item_type == graphene::net::trx_message_type && !fetch_transactions)
+            ++item_iter;
           else
           {
             // find a peer that has it, we'll use the one who has the least requests going to it to load balance
@@ -764,6 +798,17 @@ namespace graphene { namespace net { namespace detail {
         _retrigger_fetch_item_loop_promise->set_value();
     }
 
+    void node_impl::expire_old_inventory_advertised_to_peers()
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point_sec oldest_inventory_to_keep(fc::time_point::now() - fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
+      auto oldest_inventory_to_keep_iter = _inventory_advertised_to_peers.get<peer_connection::timestamp_index>()
+                                                                         .lower_bound(oldest_inventory_to_keep);
+      auto begin_iter = _inventory_advertised_to_peers.get<peer_connection::timestamp_index>().begin();
+      _inventory_advertised_to_peers.get<peer_connection::timestamp_index>()
+                                    .erase(begin_iter, oldest_inventory_to_keep_iter);
+    }
+
     void node_impl::advertise_inventory_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -794,14 +839,15 @@ namespace graphene { namespace net { namespace detail {
             //idump((inventory_to_advertise)); // for debug
             for (const item_id& item_to_advertise : inventory_to_advertise)
             {
-               auto adv_to_peer = peer->inventory_advertised_to_peer.find(item_to_advertise);
+               bool adv_to_peer = peer->inventory_advertised_to_peer.contains(item_to_advertise);
                auto adv_to_us   = peer->inventory_peer_advertised_to_us.find(item_to_advertise);
 
-              if (adv_to_peer == peer->inventory_advertised_to_peer.end() &&
+              if (!adv_to_peer &&
                   adv_to_us == peer->inventory_peer_advertised_to_us.end())
               {
                 items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(
+                peer->inventory_advertised_to_peer.insert(item_to_advertise);
+                _inventory_advertised_to_peers.insert(
                          peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
                 ++total_items_to_send;
                 if (item_to_advertise.item_type == trx_message_type)
@@ -812,9 +858,9 @@ namespace graphene { namespace net { namespace detail {
               }
               else
               {
-                 if( adv_to_peer != peer->inventory_advertised_to_peer.end() )
-                    dlog( "adv_to_peer != peer->inventory_advertised_to_peer.end() : ${adv_to_peer}",
-                          ("adv_to_peer", *adv_to_peer) );
+                 if( adv_to_peer )
+                    dlog( "already advertised ${item} to peer ${endpoint}",
+                          ("item", item_to_advertise)("endpoint", peer->get_remote_endpoint()) );
                  if( adv_to_us != peer->inventory_peer_advertised_to_us.end() )
                     dlog( "adv_to_us != peer->inventory_peer_advertised_to_us.end() : ${adv_to_us}",
                           ("adv_to_us", *adv_to_us) );
@@ -833,6 +879,7 @@ namespace graphene { namespace net { namespace detail {
           peer->clear_old_inventory();
          }
         } // lock_guard
+        expire_old_inventory_advertised_to_peers();
 
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
           iter->first->send_message(iter->second);
@@ -1439,6 +1486,15 @@ namespace graphene { namespace net { namespace detail {
         break;
       case core_message_type_enum::get_current_connections_reply_message_type:
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_block_transactions_message_type:
+        on_fetch_block_transactions_message(originating_peer, received_message.as<fetch_block_transactions_message>());
+        break;
+      case core_message_type_enum::block_transactions_message_type:
+        on_block_transactions_message(originating_peer, received_message.as<block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -2627,21 +2683,28 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
-    graphene::net::message node_impl::get_message_for_item(const item_id& item)
+    std::shared_ptr<const message> node_impl::get_message_for_item(const item_id& item)
     {
       try
       {
-        return _message_cache.get_message(item.item_hash);
+        return _message_cache.get_shared_message(item.item_hash);
       }
       catch (fc::key_not_found_exception&)
       {}
+      // blocks are queued by block id, which is the contents hash of their messages
+      if (item.item_type == block_message_type)
+      {
+        std::shared_ptr<const message> cached_block = _message_cache.find_message_by_contents_hash(item.item_hash);
+        if (cached_block && cached_block->msg_type.value() == block_message_type)
+          return cached_block;
+      }
       try
       {
-        return _delegate->get_item(item);
+        return std::make_shared<const message>(_delegate->get_item(item));
       }
       catch (fc::key_not_found_exception&)
       {}
-      return item_not_available_message(item);
+      return std::make_shared<const message>(item_not_available_message(item));
     }
 
     void node_impl::on_fetch_items_message(peer_connection* originating_peer,
@@ -2662,20 +2725,28 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      std::shared_ptr<const message> last_block_message_sent;
 
-      std::list<message> reply_messages;
+      // replies straight from the message cache are the cached messages themselves,
+      // shared by the send queues of all peers that asked for them
+      std::list<std::shared_ptr<const message>> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          std::shared_ptr<const message> requested_message = _message_cache.get_shared_message(item_hash);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
+               ("id", requested_message->id()));
           if (fetch_items_message_received.item_type == block_message_type)
+          {
             last_block_message_sent = requested_message;
+            // this is a block we've just broadcast, so the peer has most likely already received
+            // its transactions too.  Send only their ids if the peer can put the block back together
+            if (originating_peer->core_protocol_version >= GRAPHENE_NET_COMPACT_BLOCKS_PROTOCOL_VERSION)
+              requested_message = _message_cache.get_compact_block_message(item_hash);
+          }
+          reply_messages.push_back(requested_message);
           continue;
         }
         catch (fc::key_not_found_exception&)
@@ -2686,10 +2757,10 @@ namespace graphene { namespace net { namespace detail {
         item_id item_to_fetch(fetch_items_message_received.item_type, item_hash);
         try
         {
-          message requested_message = _delegate->get_item(item_to_fetch);
+          auto requested_message = std::make_shared<const message>(_delegate->get_item(item_to_fetch));
           dlog("received item request from peer ${endpoint}, returning the item from delegate with id ${id} size ${size}",
-               ("id", requested_message.id())
-               ("size", requested_message.size)
+               ("id", requested_message->id())
+               ("size", requested_message->size)
                ("endpoint", originating_peer->get_remote_endpoint()));
           reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
@@ -2698,7 +2769,7 @@ namespace graphene { namespace net { namespace detail {
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(std::make_shared<const message>(item_not_available_message(item_to_fetch)));
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
@@ -2712,10 +2783,10 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
-      for (const message& reply : reply_messages)
+      for (const std::shared_ptr<const message>& reply : reply_messages)
       {
-        if (reply.msg_type.value() == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        if (reply->msg_type.value() == block_message_type)
+          originating_peer->send_item(item_id(block_message_type, reply->as<graphene::net::block_message>().block_id));
         else
           originating_peer->send_message(reply);
       }
@@ -2761,6 +2832,19 @@ namespace graphene { namespace net { namespace detail {
         return;
       }
 
+      auto compact_block_iter = originating_peer->compact_blocks_being_completed.find(requested_item.item_hash);
+      if (requested_item.item_type == block_message_type &&
+          compact_block_iter != originating_peer->compact_blocks_being_completed.end())
+      {
+        // we can't complete the block, disconnecting makes us fetch it from another peer
+        originating_peer->compact_blocks_being_completed.erase(compact_block_iter);
+        wlog( "Peer ${peer} doesn't have the transactions of the compact block ${item} it sent us.",
+              ("peer", originating_peer->get_remote_endpoint())
+              ("item", requested_item) );
+        disconnect_from_peer(originating_peer, "You sent me a compact block whose transactions you don't have");
+        return;
+      }
+
       dlog("Peer doesn't have an item we're looking for, which is fine because we weren't looking for it");
     }
 
@@ -2779,6 +2863,7 @@ namespace graphene { namespace net { namespace detail {
       // expire old inventory
       // so we'll be making our decisions about whether to fetch blocks below based only on recent inventory
       originating_peer->clear_old_inventory();
+      expire_old_inventory_advertised_to_peers();
 
       dlog( "received inventory of ${count} items from peer ${endpoint}",
             ("count", item_ids_inventory_message_received.item_hashes_available.size())
@@ -2786,21 +2871,25 @@ namespace graphene { namespace net { namespace detail {
       for( const item_hash_t& item_hash : item_ids_inventory_message_received.item_hashes_available )
       {
         item_id advertised_item_id(item_ids_inventory_message_received.item_type, item_hash);
-        bool we_advertised_this_item_to_a_peer = false;
+        bool we_advertised_this_item_to_a_peer =
+              _inventory_advertised_to_peers.find(advertised_item_id) != _inventory_advertised_to_peers.end();
         bool we_requested_this_item_from_a_peer = false;
+        if (!we_advertised_this_item_to_a_peer)
         {
            fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
             for (const peer_connection_ptr& peer : _active_connections)
             {
-               if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
+               if (peer->items_requested_from_peer.find(advertised_item_id) != peer->items_requested_from_peer.end())
                {
-                  we_advertised_this_item_to_a_peer = true;
+                  we_requested_this_item_from_a_peer = true;
                   break;
                }
-               if (peer->items_requested_from_peer.find(advertised_item_id) != peer->items_requested_from_peer.end())
-                  we_requested_this_item_from_a_peer = true;
             }
         }
+        // a transaction we've received already but haven't handed to the client yet
+        if (advertised_item_id.item_type == trx_message_type &&
+            _received_transaction_hashes.find(item_hash) != _received_transaction_hashes.end())
+          we_requested_this_item_from_a_peer = true;
 
         // if we have already advertised it to a peer, we must have it, no need to do anything else
         if (!we_advertised_this_item_to_a_peer)
@@ -3178,10 +3267,9 @@ namespace graphene { namespace net { namespace detail {
 
       do
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
-        _new_received_sync_items.clear();
+        // the items are relinked, not moved, as they may still be accessed by their precomputation
+        _new_received_sync_items.reverse();
+        _received_sync_items.splice(_received_sync_items.begin(), _new_received_sync_items);
         dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
 
         block_processed_this_iteration = false;
@@ -3197,11 +3285,11 @@ namespace graphene { namespace net { namespace detail {
             for (const peer_connection_ptr& peer : _active_connections)
             {
                if (!peer->ids_of_items_to_get.empty() &&
-                     peer->ids_of_items_to_get.front() == received_block_iter->block_id)
+                     peer->ids_of_items_to_get.front() == received_block_iter->message.block_id)
                {
                   potential_first_block = true;
                   peer->ids_of_items_to_get.pop_front();
-                  peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
+                  peer->ids_of_items_being_processed.insert(received_block_iter->message.block_id);
                }
             }
           }
@@ -3216,9 +3304,24 @@ namespace graphene { namespace net { namespace detail {
             // we don't know they're the same (for the peer in normal operation, it has only told us the
             // message id, for the peer in the sync case we only known the block_id).
             if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
+                          received_block_iter->message.block_id) == _most_recent_blocks_accepted.end())
             {
-              graphene::net::block_message block_message_to_process = *received_block_iter;
+              // usually done long ago, the block has been waiting for its predecessors
+              try
+              {
+                received_block_iter->precomputed.wait();
+              }
+              catch (const fc::canceled_exception&)
+              {
+                throw;
+              }
+              catch (const fc::exception& e)
+              {
+                // the block is invalid, pushing it will fail and handle that
+                dlog("precomputation of sync block ${id} failed: ${e}",
+                     ("id", received_block_iter->message.block_id)("e", e));
+              }
+              graphene::net::block_message block_message_to_process = received_block_iter->message;
               _received_sync_items.erase(received_block_iter);
               _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
                 send_sync_block_to_node_delegate(block_message_to_process);
@@ -3233,7 +3336,7 @@ namespace graphene { namespace net { namespace detail {
               fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
               for (const peer_connection_ptr& peer : _active_connections)
               {
-                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_iter->block_id);
+                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_iter->message.block_id);
                 if (items_being_processed_iter != peer->ids_of_items_being_processed.end())
                 {
                   peer->ids_of_items_being_processed.erase(items_being_processed_iter);
@@ -3295,7 +3398,17 @@ namespace graphene { namespace net { namespace detail {
 
       // add it to the front of _received_sync_items, then process _received_sync_items to try to
       // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      _new_received_sync_items.emplace_front( block_message_to_process );
+      received_sync_item& item = _new_received_sync_items.front();
+      try
+      {
+        item.precomputed = _delegate->precompute_block( item.message );
+      }
+      catch (const fc::exception& e)
+      {
+        dlog("failed to start precomputation of sync block ${id}: ${e}", ("id", item.message.block_id)("e", e));
+        item.precomputed = fc::future<void>( fc::promise<void>::create( true ) );
+      }
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -3542,6 +3655,187 @@ namespace graphene { namespace net { namespace detail {
       disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
     }
 
+    void node_impl::on_compact_block_message(peer_connection* originating_peer,
+                                             const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      // we request blocks by the hash of their block_message, which we can't know until the block is complete,
+      // so for now we can only check that we are waiting for a block from this peer at all
+      bool block_requested = std::any_of(originating_peer->items_requested_from_peer.begin(),
+                                         originating_peer->items_requested_from_peer.end(),
+                                         [](const peer_connection::item_to_time_map_type::value_type& item_and_time) {
+                                           return item_and_time.first.item_type == block_message_type;
+                                         });
+      if (!block_requested ||
+          originating_peer->compact_blocks_being_completed.find(compact_block_message_received.block_id) !=
+          originating_peer->compact_blocks_being_completed.end())
+      {
+        wlog("received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a block that I didn't ask for, block_id: ${block_id}",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      // take the transactions we've received and broadcast ourselves from the message cache
+      signed_block block;
+      static_cast<signed_block_header&>(block) = compact_block_message_received.header;
+      block.transactions.reserve(compact_block_message_received.transactions.size());
+      std::vector<uint32_t> missing_transaction_indexes;
+      for (const compact_block_transaction& transaction : compact_block_message_received.transactions)
+      {
+        std::shared_ptr<const message> cached_message = _message_cache.find_message_by_contents_hash(transaction.id);
+        if (cached_message && cached_message->msg_type.value() == trx_message_type)
+          block.transactions.emplace_back(cached_message->as<trx_message>().trx);
+        else
+        {
+          missing_transaction_indexes.push_back((uint32_t)block.transactions.size());
+          block.transactions.emplace_back();
+        }
+        block.transactions.back().operation_results = transaction.operation_results;
+      }
+      dlog("received compact block ${id} with ${count} transactions from peer ${endpoint}, ${missing} of them not in my cache",
+           ("id", compact_block_message_received.block_id)
+           ("count", block.transactions.size())
+           ("missing", missing_transaction_indexes.size())
+           ("endpoint", originating_peer->get_remote_endpoint()));
+
+      if (missing_transaction_indexes.empty())
+      {
+        bool all_transactions_fetched = block.transactions.empty();
+        process_completed_compact_block(originating_peer, std::move(block), all_transactions_fetched);
+        return;
+      }
+
+      fetch_block_transactions_message request(compact_block_message_received.block_id, missing_transaction_indexes);
+      originating_peer->compact_blocks_being_completed[compact_block_message_received.block_id] =
+            std::make_pair(std::move(block), std::move(missing_transaction_indexes));
+      originating_peer->send_message(request);
+    }
+
+    void node_impl::on_fetch_block_transactions_message(peer_connection* originating_peer,
+                                                        const fetch_block_transactions_message& fetch_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      // Gatekeeping code
+      if( originating_peer->their_state != peer_connection::their_connection_state::connection_accepted )
+      {
+         wlog( "Unexpected fetch_block_transactions_message from peer ${peer}, disconnecting",
+               ("peer", originating_peer->get_remote_endpoint()) );
+         disconnect_from_peer( originating_peer, "Received an unexpected fetch_block_transactions_message" );
+         return;
+      }
+
+      item_id requested_item(block_message_type, fetch_block_transactions_message_received.block_id);
+      graphene::net::block_message requested_block;
+      try
+      {
+        std::shared_ptr<const message> cached_message =
+              _message_cache.find_message_by_contents_hash(fetch_block_transactions_message_received.block_id);
+        if (cached_message && cached_message->msg_type.value() == block_message_type)
+          requested_block = cached_message->as<graphene::net::block_message>();
+        else
+          requested_block = _delegate->get_item(requested_item).as<graphene::net::block_message>();
+      }
+      catch (const fc::canceled_exception&)
+      {
+        throw;
+      }
+      catch (const fc::exception&)
+      {
+        dlog("received a request for transactions of block ${id} from peer ${endpoint} but we don't have it",
+             ("id", fetch_block_transactions_message_received.block_id)
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        originating_peer->send_message(item_not_available_message(requested_item));
+        return;
+      }
+
+      block_transactions_message reply(fetch_block_transactions_message_received.block_id,
+                                       fetch_block_transactions_message_received.transaction_indexes);
+      reply.transactions.reserve(fetch_block_transactions_message_received.transaction_indexes.size());
+      for (uint32_t transaction_index : fetch_block_transactions_message_received.transaction_indexes)
+      {
+        if (transaction_index >= requested_block.block.transactions.size())
+        {
+          wlog("Peer ${peer} asked for transaction ${index} of block ${id} which only has ${count}, disconnecting",
+               ("peer", originating_peer->get_remote_endpoint())
+               ("index", transaction_index)
+               ("id", fetch_block_transactions_message_received.block_id)
+               ("count", requested_block.block.transactions.size()));
+          disconnect_from_peer(originating_peer, "You asked for a transaction that is not in the block");
+          return;
+        }
+        reply.transactions.emplace_back(requested_block.block.transactions[transaction_index]);
+      }
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_block_transactions_message(peer_connection* originating_peer,
+                                                  const block_transactions_message& block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto iter = originating_peer->compact_blocks_being_completed.find(block_transactions_message_received.block_id);
+      if (iter == originating_peer->compact_blocks_being_completed.end() ||
+          iter->second.second != block_transactions_message_received.transaction_indexes ||
+          block_transactions_message_received.transactions.size() !=
+          block_transactions_message_received.transaction_indexes.size())
+      {
+        wlog("received transactions of block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", block_transactions_message_received.block_id));
+        disconnect_from_peer(originating_peer, "You sent me block transactions that I didn't ask for");
+        return;
+      }
+
+      signed_block block = std::move(iter->second.first);
+      bool all_transactions_fetched = block_transactions_message_received.transaction_indexes.size()
+                                      == block.transactions.size();
+      originating_peer->compact_blocks_being_completed.erase(iter);
+      for (size_t i = 0; i < block_transactions_message_received.transactions.size(); ++i)
+      {
+        graphene::protocol::processed_transaction& transaction =
+              block.transactions[block_transactions_message_received.transaction_indexes[i]];
+        std::vector<graphene::protocol::operation_result> operation_results = std::move(transaction.operation_results);
+        transaction = graphene::protocol::processed_transaction(block_transactions_message_received.transactions[i]);
+        transaction.operation_results = std::move(operation_results);
+      }
+      process_completed_compact_block(originating_peer, std::move(block), all_transactions_fetched);
+    }
+
+    void node_impl::process_completed_compact_block(peer_connection* originating_peer,
+                                                    signed_block&& block,
+                                                    bool all_transactions_fetched)
+    {
+      VERIFY_CORRECT_THREAD();
+      graphene::net::block_message block_message_to_process;
+      block_message_to_process.block = std::move(block);
+      block_message_to_process.block_id = block_message_to_process.block.id();
+      message message_to_process(block_message_to_process);
+      message_hash_type message_hash = message_to_process.id();
+
+      if (!all_transactions_fetched &&
+          originating_peer->items_requested_from_peer.find(item_id(block_message_type, message_hash)) ==
+          originating_peer->items_requested_from_peer.end())
+      {
+        // it isn't the block we asked for, most likely because a transaction we took from our cache
+        // differs from the one in the block, e.g. in its signatures.  Ask for all of them
+        dlog("compact block ${id} from peer ${endpoint} doesn't match the block we asked for, fetching all its transactions",
+             ("id", block_message_to_process.block_id)
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        std::vector<uint32_t> all_transaction_indexes(block_message_to_process.block.transactions.size());
+        std::iota(all_transaction_indexes.begin(), all_transaction_indexes.end(), 0u);
+        fetch_block_transactions_message request(block_message_to_process.block_id, all_transaction_indexes);
+        originating_peer->compact_blocks_being_completed[block_message_to_process.block_id] =
+              std::make_pair(std::move(block_message_to_process.block), std::move(all_transaction_indexes));
+        originating_peer->send_message(request);
+        return;
+      }
+
+      process_block_message(originating_peer, message_to_process, message_hash);
+    }
+
     void node_impl::on_current_time_request_message(peer_connection* originating_peer,
                                                     const current_time_request_message& current_time_request_message_received)
     {
@@ -3568,6 +3862,35 @@ namespace graphene { namespace net { namespace detail {
                                              - current_time_reply_message_received.request_received_time );
     }
 
+    /// Logs why the client rejected an item a peer sent us, in debug level for the common reasons
+    static void log_rejected_item( const fc::optional<fc::ip::endpoint>& peer_endpoint, const fc::exception& e )
+    {
+      switch( e.code() )
+      {
+      // log common exceptions in debug level
+      case graphene::chain::duplicate_transaction::code_enum::code_value :
+      case graphene::chain::limit_order_create_kill_unfilled::code_enum::code_value :
+      case graphene::chain::limit_order_create_market_not_whitelisted::code_enum::code_value :
+      case graphene::chain::limit_order_create_market_blacklisted::code_enum::code_value :
+      case graphene::chain::limit_order_create_selling_asset_unauthorized::code_enum::code_value :
+      case graphene::chain::limit_order_create_receiving_asset_unauthorized::code_enum::code_value :
+      case graphene::chain::limit_order_create_insufficient_balance::code_enum::code_value :
+      case graphene::chain::limit_order_update_nonexist_order::code_enum::code_value :
+      case graphene::chain::limit_order_update_owner_mismatch::code_enum::code_value :
+      case graphene::chain::limit_order_cancel_nonexist_order::code_enum::code_value :
+      case graphene::chain::limit_order_cancel_owner_mismatch::code_enum::code_value :
+      case graphene::chain::liquidity_pool_exchange_unfillable_price::code_enum::code_value :
+         dlog( "client rejected message sent by peer ${peer}, ${e}",
+               ("peer", peer_endpoint )("e", e) );
+         break;
+      // log rarer exceptions in warn level
+      default:
+         wlog( "client rejected message sent by peer ${peer}, ${e}",
+               ("peer", peer_endpoint )("e", e) );
+         break;
+      }
+    }
+
     // this handles any message we get that doesn't require any special processing.
     // currently, this is any message other than block messages and p2p-specific
     // messages.  (transaction messages would be handled here, for example)
@@ -3599,19 +3922,25 @@ namespace graphene { namespace net { namespace detail {
         if (originating_peer->idle())
           trigger_fetch_items_loop();
 
+        if (message_to_process.msg_type.value() == trx_message_type)
+        {
+          // transactions are handed to the delegate in batches, see process_received_transactions()
+          received_transaction transaction_to_process { message_to_process.as<trx_message>(), message_to_process,
+                                                        message_hash, message_receive_time, originating_peer->node_id,
+                                                        originating_peer->get_remote_endpoint() };
+          dlog( "queueing message containing transaction ${trx} for the client",
+                ("trx", transaction_to_process.transaction_message.trx.id()) );
+          _received_transactions.push_back( std::move(transaction_to_process) );
+          _received_transaction_hashes.insert( message_hash );
+          trigger_process_received_transactions();
+          return;
+        }
+
         // Next: have the delegate process the message
         fc::time_point message_validated_time;
         try
         {
-          if (message_to_process.msg_type.value() == trx_message_type)
-          {
-            trx_message transaction_message_to_process = message_to_process.as<trx_message>();
-            dlog( "passing message containing transaction ${trx} to client",
-                  ("trx", transaction_message_to_process.trx.id()) );
-            _delegate->handle_transaction(transaction_message_to_process);
-          }
-          else
-            _delegate->handle_message( message_to_process );
+          _delegate->handle_message( message_to_process );
           message_validated_time = fc::time_point::now();
         }
         catch ( const fc::canceled_exception& )
@@ -3620,30 +3949,7 @@ namespace graphene { namespace net { namespace detail {
         }
         catch ( const fc::exception& e )
         {
-          switch( e.code() )
-          {
-          // log common exceptions in debug level
-          case graphene::chain::duplicate_transaction::code_enum::code_value :
-          case graphene::chain::limit_order_create_kill_unfilled::code_enum::code_value :
-          case graphene::chain::limit_order_create_market_not_whitelisted::code_enum::code_value :
-          case graphene::chain::limit_order_create_market_blacklisted::code_enum::code_value :
-          case graphene::chain::limit_order_create_selling_asset_unauthorized::code_enum::code_value :
-          case graphene::chain::limit_order_create_receiving_asset_unauthorized::code_enum::code_value :
-          case graphene::chain::limit_order_create_insufficient_balance::code_enum::code_value :
-          case graphene::chain::limit_order_update_nonexist_order::code_enum::code_value :
-          case graphene::chain::limit_order_update_owner_mismatch::code_enum::code_value :
-          case graphene::chain::limit_order_cancel_nonexist_order::code_enum::code_value :
-          case graphene::chain::limit_order_cancel_owner_mismatch::code_enum::code_value :
-          case graphene::chain::liquidity_pool_exchange_unfillable_price::code_enum::code_value :
-             dlog( "client rejected message sent by peer ${peer}, ${e}",
-                   ("peer", originating_peer->get_remote_endpoint() )("e", e) );
-             break;
-          // log rarer exceptions in warn level
-          default:
-             wlog( "client rejected message sent by peer ${peer}, ${e}",
-                   ("peer", originating_peer->get_remote_endpoint() )("e", e) );
-             break;
-          }
+          log_rejected_item( originating_peer->get_remote_endpoint(), e );
           // record it so we don't try to fetch this item again
           _recently_failed_items.insert( peer_connection::timestamped_item_id(
                 item_id( message_to_process.msg_type.value(), message_hash ), fc::time_point::now() ) );
@@ -3657,6 +3963,75 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
+    void node_impl::trigger_process_received_transactions()
+    {
+      if (!_node_is_shutting_down &&
+          (!_process_received_transactions_done.valid() || _process_received_transactions_done.ready()))
+        _process_received_transactions_done = fc::async( [this](){ process_received_transactions(); },
+                                                         "process_received_transactions" );
+    }
+
+    void node_impl::process_received_transactions()
+    {
+      VERIFY_CORRECT_THREAD();
+      // the transactions that come in while the delegate handles a batch make up the next one, so that the
+      // delegate can recover their signing keys in parallel instead of one transaction after the other
+      while (!_received_transactions.empty())
+      {
+        size_t batch_size = std::min<size_t>(_received_transactions.size(), GRAPHENE_NET_MAX_TRX_PER_BATCH);
+        std::vector<received_transaction> batch(std::make_move_iterator(_received_transactions.begin()),
+                                                std::make_move_iterator(_received_transactions.begin() + batch_size));
+        const bool queue_was_full = _received_transactions.size() >= GRAPHENE_NET_MAX_QUEUED_TRX;
+        _received_transactions.erase(_received_transactions.begin(), _received_transactions.begin() + batch_size);
+        if (queue_was_full && _received_transactions.size() < GRAPHENE_NET_MAX_QUEUED_TRX)
+          trigger_fetch_items_loop();
+
+        std::vector<trx_message> transaction_messages;
+        transaction_messages.reserve(batch.size());
+        for (const received_transaction& transaction : batch)
+          transaction_messages.push_back(transaction.transaction_message);
+        dlog("passing ${count} transactions to client", ("count", batch.size()));
+
+        std::vector<fc::oexception> results;
+        try
+        {
+          results = _delegate->handle_transactions(transaction_messages);
+        }
+        catch ( const fc::canceled_exception& )
+        {
+          throw;
+        }
+        catch ( const fc::exception& e )
+        {
+          results.assign(batch.size(), e);
+        }
+        if (results.size() != batch.size())
+          results.assign(batch.size(), fc::exception(FC_LOG_MESSAGE(error,
+                "The client returned ${n} results for ${count} transactions",
+                ("n", results.size())("count", batch.size()))));
+        fc::time_point message_validated_time = fc::time_point::now();
+
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+          const received_transaction& transaction = batch[i];
+          _received_transaction_hashes.erase(transaction.message_hash);
+          if (results[i])
+          {
+            log_rejected_item(transaction.originating_peer_endpoint, *results[i]);
+            // record it so we don't try to fetch this item again
+            _recently_failed_items.insert( peer_connection::timestamped_item_id(
+                  item_id( trx_message_type, transaction.message_hash ), fc::time_point::now() ) );
+            continue;
+          }
+
+          // finally, if the delegate validated the transaction, broadcast it to our other peers
+          message_propagation_data propagation_data { transaction.received_time, message_validated_time,
+                                                      transaction.originating_peer };
+          broadcast( transaction.message_to_broadcast, propagation_data );
+        }
+      }
+    }
+
     void node_impl::start_synchronizing_with_peer( const peer_connection_ptr& peer )
     {
       VERIFY_CORRECT_THREAD();
@@ -3763,6 +4138,24 @@ namespace graphene { namespace net { namespace detail {
         wlog( "Exception thrown while terminating P2P connect loop, ignoring" );
       }
 
+      try
+      {
+        _process_received_transactions_done.cancel_and_wait("node_impl::close()");
+        dlog("Process received transactions task terminated");
+      }
+      catch ( const fc::canceled_exception& )
+      {
+        dlog("Process received transactions task terminated");
+      }
+      catch ( const fc::exception& e )
+      {
+        wlog( "Exception thrown while terminating Process received transactions task, ignoring: ${e}", ("e", e) );
+      }
+      catch (...)
+      {
+        wlog( "Exception thrown while terminating Process received transactions task, ignoring" );
+      }
+
       try
       {
         _process_backlog_of_sync_blocks_done.cancel_and_wait("node_impl::close()");
@@ -3812,6 +4205,20 @@ namespace graphene { namespace net { namespace detail {
         }
       }
 
+      // the precomputations refer to the sync items, which are destroyed with this object
+      for (std::list<received_sync_item>* items : { &_new_received_sync_items, &_received_sync_items })
+        for (received_sync_item& item : *items)
+        {
+          try
+          {
+            if (item.precomputed.valid())
+              item.precomputed.wait();
+          }
+          catch (...)
+          {
+          }
+        }
+
       try
       {
         _fetch_sync_items_loop_done.cancel("node_impl::close()");
@@ -4662,6 +5069,7 @@ namespace graphene { namespace net { namespace detail {
       ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
+      ilog( "node._inventory_advertised_to_peers size: ${size}", ("size", _inventory_advertised_to_peers.size() ) );
       ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
       fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
       for( const peer_connection_ptr& peer : _active_connections )
@@ -4669,7 +5077,7 @@ namespace graphene { namespace net { namespace detail {
         ilog( "  peer ${endpoint}", ("endpoint", peer->get_remote_endpoint() ) );
         ilog( "    peer.ids_of_items_to_get size: ${size}", ("size", peer->ids_of_items_to_get.size() ) );
         ilog( "    peer.inventory_peer_advertised_to_us size: ${size}", ("size", peer->inventory_peer_advertised_to_us.size() ) );
-        ilog( "    peer.inventory_advertised_to_peer size: ${size}", ("size", peer->inventory_advertised_to_peer.size() ) );
+        ilog( "    peer.inventory_advertised_to_peer size: about ${size}", ("size", peer->inventory_advertised_to_peer.size() ) );
         ilog( "    peer.items_requested_from_peer size: ${size}", ("size", peer->items_requested_from_peer.size() ) );
         ilog( "    peer.sync_items_requested_from_peer size: ${size}", ("size", peer->sync_items_requested_from_peer.size() ) );
       }
@@ -5350,6 +5758,12 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(handle_transaction, transaction_message);
     }
 
+    std::vector<fc::oexception> statistics_gathering_node_delegate_wrapper::handle_transactions(
+          const std::vector<graphene::net::trx_message>& transaction_messages )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(handle_transactions, transaction_messages);
+    }
+
     std::vector<item_hash_t> statistics_gathering_node_delegate_wrapper::get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                                                                        uint32_t& remaining_item_count,
                                                                                        uint32_t limit /* = 2000 */)
@@ -5414,6 +5828,13 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_current_block_interval_in_seconds);
     }
 
+    fc::future<void> statistics_gathering_node_delegate_wrapper::precompute_block(
+          const graphene::net::block_message& block_message )const
+    {
+      // only starts the work, no need to switch to the delegate thread
+      return _node_delegate->precompute_block( block_message );
+    }
+
 #undef INVOKE_AND_COLLECT_STATISTICS
 
   } // end namespace detail
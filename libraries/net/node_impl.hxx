@@ -19,7 +19,9 @@
 #define testnetlog(...) do {} while (0)
 #endif
 
+#include <deque>
 #include <memory>
+#include <set>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
 #include <boost/accumulators/statistics/rolling_mean.hpp>
@@ -167,7 +169,9 @@ private:
    struct message_info
    {
       message_hash_type message_hash;
-      message           message_body;
+      std::shared_ptr<const message> message_body; ///< shared with the send queues of the peers it is sent to
+      /// for a block, its compact_block_message, built when the first peer asks for it
+      mutable std::shared_ptr<const message> compact_block_body;
       uint32_t          block_clock_when_received;
 
       /// for network performance stats
@@ -182,7 +186,7 @@ private:
                     const message_propagation_data& propagation_data,
                     message_hash_type        message_contents_hash ) :
             message_hash( message_hash ),
-            message_body( message_body ),
+            message_body( std::make_shared<const message>( message_body ) ),
             block_clock_when_received( block_clock_when_received ),
             propagation_data( propagation_data ),
             message_contents_hash( message_contents_hash )
@@ -209,6 +213,13 @@ public:
                        const message_propagation_data& propagation_data,
                        const message_hash_type& message_content_hash );
    message get_message( const message_hash_type& hash_of_message_to_lookup ) const;
+   /// @return the cached message itself, to send it without copying
+   std::shared_ptr<const message> get_shared_message( const message_hash_type& hash_of_message_to_lookup ) const;
+   /// @return the cached message with the given contents hash, e.g. the transaction with that id, or nullptr
+   std::shared_ptr<const message> find_message_by_contents_hash(
+         const message_hash_type& hash_of_msg_contents_to_lookup ) const;
+   /// @return the cached block message as a compact_block_message, which is built once per block
+   std::shared_ptr<const message> get_compact_block_message( const message_hash_type& hash_of_message_to_lookup ) const;
    message_propagation_data get_message_propagation_data(
          const message_hash_type& hash_of_msg_contents_to_lookup ) const;
    size_t size() const { return _message_cache.size(); }
@@ -253,6 +264,7 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
                                (handle_message) \
                                (handle_block) \
                                (handle_transaction) \
+                               (handle_transactions) \
                                (get_block_ids) \
                                (get_item) \
                                (get_chain_id) \
@@ -352,6 +364,8 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
       bool handle_block( const graphene::net::block_message& block_message, bool sync_mode,
                          std::vector<message_hash_type>& contained_transaction_msg_ids ) override;
       void handle_transaction( const graphene::net::trx_message& transaction_message ) override;
+      std::vector<fc::oexception> handle_transactions(
+            const std::vector<graphene::net::trx_message>& transaction_messages ) override;
       std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                              uint32_t& remaining_item_count,
                                              uint32_t limit = 2000) override;
@@ -367,6 +381,7 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
       uint32_t estimate_last_known_fork_from_git_revision_timestamp(uint32_t unix_timestamp) const override;
       void error_encountered(const std::string& message, const fc::oexception& error) override;
       uint8_t get_current_block_interval_in_seconds() const override;
+      fc::future<void> precompute_block( const graphene::net::block_message& block_message )const override;
 };
 
 /// This specifies configuration info for the local node.  It's stored as JSON
@@ -439,14 +454,38 @@ public:
 
       /// List of sync blocks we've asked for from peers but have not yet received
       active_sync_requests_map              _active_sync_requests;
+      /// A sync block, with the precomputation started on it when it was received
+      struct received_sync_item
+      {
+         explicit received_sync_item( const graphene::net::block_message& msg ) : message( msg ) {}
+         graphene::net::block_message message;
+         /// The message must not be accessed before this is ready
+         fc::future<void>             precomputed;
+      };
       /// List of sync blocks we've just received but haven't yet tried to process
-      std::list<graphene::net::block_message> _new_received_sync_items;
+      std::list<received_sync_item> _new_received_sync_items;
       /// List of sync blocks we've received, but can't yet process because we are still missing blocks
       /// that come earlier in the chain
-      std::list<graphene::net::block_message> _received_sync_items;
+      std::list<received_sync_item> _received_sync_items;
       /// @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
+
+      /// A transaction received from a peer, waiting to be handed to the client with the others in its batch
+      struct received_transaction
+      {
+        trx_message                    transaction_message;
+        message                        message_to_broadcast;
+        message_hash_type              message_hash;
+        fc::time_point                 received_time;
+        node_id_t                      originating_peer;
+        fc::optional<fc::ip::endpoint> originating_peer_endpoint;
+      };
+      /// Transactions received while the client handles the previous batch
+      std::deque<received_transaction> _received_transactions;
+      /// Message hashes of the transactions in _received_transactions and the batch being handled
+      std::set<message_hash_type> _received_transaction_hashes;
+      fc::future<void> _process_received_transactions_done;
       bool _suspend_fetching_sync_blocks = false;
 
       /// Used by the task that fetches items during normal operation
@@ -480,6 +519,9 @@ public:
       fc::future<void>              _advertise_inventory_loop_done;
       /// List of items we have received but not yet advertised to our peers
       concurrent_unordered_set<item_id>   _new_inventory;
+      /// Items we have advertised to at least one peer recently, so we must have them.  Kept here once
+      /// rather than looked up in the inventory of every peer, which is only a Bloom filter
+      peer_connection::timestamped_items_set_type _inventory_advertised_to_peers;
       /// @}
 
       fc::future<void>     _kill_inactive_conns_loop_done;
@@ -635,6 +677,7 @@ public:
 
       void advertise_inventory_loop();
       void trigger_advertise_inventory_loop();
+      void expire_old_inventory_advertised_to_peers();
 
       void kill_inactive_conns_loop(node_impl_ptr self);
 
@@ -698,6 +741,15 @@ public:
       void on_current_time_reply_message( peer_connection* originating_peer,
                                           const current_time_reply_message& current_time_reply_message_received );
 
+      void on_compact_block_message( peer_connection* originating_peer,
+                                     const compact_block_message& compact_block_message_received );
+
+      void on_fetch_block_transactions_message( peer_connection* originating_peer,
+                                                const fetch_block_transactions_message& fetch_block_transactions_message_received );
+
+      void on_block_transactions_message( peer_connection* originating_peer,
+                                          const block_transactions_message& block_transactions_message_received );
+
       void on_connection_closed(peer_connection* originating_peer) override;
 
       void send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send);
@@ -715,11 +767,17 @@ public:
                   peer_connection* originating_peer,
                   const message& message_to_process,
                   const message_hash_type& message_hash);
+      void process_completed_compact_block(
+                  peer_connection* originating_peer,
+                  signed_block&& block,
+                  bool all_transactions_fetched);
 
       void process_ordinary_message(
                   peer_connection* originating_peer,
                   const message& message_to_process,
                   const message_hash_type& message_hash);
+      void process_received_transactions();
+      void trigger_process_received_transactions();
 
       void start_synchronizing();
       void start_synchronizing_with_peer(const peer_connection_ptr& peer);
@@ -801,7 +859,7 @@ public:
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second,
                                                             uint32_t download_bytes_per_second );
       fc::variant_object         get_call_statistics() const;
-      graphene::net::message     get_message_for_item(const item_id& item) override;
+      std::shared_ptr<const message> get_message_for_item(const item_id& item) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
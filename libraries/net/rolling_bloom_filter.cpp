@@ -0,0 +1,86 @@
+/*
+ * AcloudBank
+ */
+#include <graphene/net/rolling_bloom_filter.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace graphene { namespace net {
+
+  namespace {
+    /// Item hashes are already ripemd160 hashes of the messages, so their words serve as the two hashes
+    /// that all of the filter's hash functions are derived from (double hashing)
+    void hash_item( const item_id& item, uint64_t& h1, uint64_t& h2 )
+    {
+      const uint32_t* words = item.item_hash._hash;
+      h1 = ( ( uint64_t(words[0]) << 32 ) | words[1] ) ^ ( uint64_t(item.item_type) * 0x9e3779b97f4a7c15ULL );
+      h2 = ( ( uint64_t(words[2]) << 32 ) | words[3] ) | 1;
+    }
+  }
+
+  rolling_bloom_filter::rolling_bloom_filter( uint32_t items_per_generation, double false_positive_rate,
+                                              fc::microseconds generation_duration ) :
+    _items_per_generation( items_per_generation ),
+    _generation_duration( generation_duration )
+  {
+    FC_ASSERT( items_per_generation > 0 && false_positive_rate > 0 && false_positive_rate < 1 );
+    const double ln2 = std::log( 2.0 );
+    const double bits = -std::log( false_positive_rate ) * items_per_generation / ( ln2 * ln2 );
+    _number_of_bits = std::max<uint64_t>( 64, 64 * uint64_t( std::ceil( bits / 64 ) ) );
+    _number_of_hashes = std::max<uint32_t>( 1, uint32_t( std::round( double(_number_of_bits) / items_per_generation
+                                                                     * ln2 ) ) );
+    start_new_generation();
+  }
+
+  void rolling_bloom_filter::start_new_generation()
+  {
+    std::swap( _previous, _current );
+    _current.bits.assign( _number_of_bits / 64, 0 );
+    _current.item_count = 0;
+    _current.start_time = fc::time_point::now();
+  }
+
+  void rolling_bloom_filter::expire_old_items()
+  {
+    if( fc::time_point::now() - _current.start_time >= _generation_duration )
+      start_new_generation();
+  }
+
+  void rolling_bloom_filter::insert( const item_id& item )
+  {
+    if( _current.item_count >= _items_per_generation )
+      start_new_generation();
+    uint64_t h1, h2;
+    hash_item( item, h1, h2 );
+    for( uint32_t i = 0; i < _number_of_hashes; ++i )
+    {
+      const uint64_t bit = ( h1 + i * h2 ) % _number_of_bits;
+      _current.bits[bit / 64] |= uint64_t(1) << ( bit % 64 );
+    }
+    ++_current.item_count;
+  }
+
+  bool rolling_bloom_filter::generation_contains( const generation& g, uint64_t h1, uint64_t h2 ) const
+  {
+    if( g.item_count == 0 )
+      return false;
+    for( uint32_t i = 0; i < _number_of_hashes; ++i )
+    {
+      const uint64_t bit = ( h1 + i * h2 ) % _number_of_bits;
+      if( ( g.bits[bit / 64] & ( uint64_t(1) << ( bit % 64 ) ) ) == 0 )
+        return false;
+    }
+    return true;
+  }
+
+  bool rolling_bloom_filter::contains( const item_id& item ) const
+  {
+    uint64_t h1, h2;
+    hash_item( item, h1, h2 );
+    return generation_contains( _current, h1, h2 ) || generation_contains( _previous, h1, h2 );
+  }
+
+} } // graphene::net
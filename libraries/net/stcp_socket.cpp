@@ -14,6 +14,9 @@
 
 namespace graphene { namespace net {
 
+constexpr size_t stcp_socket::read_buffer_length;
+constexpr size_t stcp_socket::write_buffer_length;
+
 stcp_socket::stcp_socket()
 //:_buf_len(0)
 #ifndef NDEBUG
@@ -59,13 +62,14 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
 }
 
 /**
- *   This method must read at least 16 bytes at a time from
- *   the underlying TCP socket so that it can decrypt them. It
- *   will buffer any left-over.
+ *   This method reads whatever has arrived on the underlying TCP socket, up to a full
+ *   read buffer and rounded up to whole 16 byte blocks so that it can decrypt them in
+ *   one pass.  What doesn't fit in @p buffer is kept decrypted for the next calls, so
+ *   small reads like message headers don't each cost a read from the socket.
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
-    assert( len > 0 && (len % 16) == 0 );
+    assert( len > 0 );
 
 #ifndef NDEBUG
     // This code was written with the assumption that you'd only be making one call to readsome 
@@ -78,20 +82,32 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
     if (!_read_buffer)
       _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
 
-    len = std::min<size_t>(read_buffer_length, len);
-
-    size_t s = _sock.readsome( _read_buffer, len, 0 );
-    if( s % 16 ) 
+    if (_read_buffer_begin == _read_buffer_end)
     {
-      _sock.read(_read_buffer, 16 - (s%16), s);
-      s += 16-(s%16);
+      size_t s = _sock.readsome( _read_buffer, read_buffer_length, 0 );
+      if( s % 16 ) 
+      {
+        _sock.read(_read_buffer, 16 - (s%16), s);
+        s += 16-(s%16);
+      }
+      if (s <= len)
+      {
+        // it all fits, decrypt straight into the caller's buffer
+        _recv_aes.decode( _read_buffer.get(), s, buffer );
+        return s;
+      }
+      _recv_aes.decode( _read_buffer.get(), s, _read_buffer.get() );
+      _read_buffer_begin = 0;
+      _read_buffer_end = s;
     }
-    _recv_aes.decode( _read_buffer.get(), s, buffer );
-    return s;
+
+    len = std::min<size_t>(_read_buffer_end - _read_buffer_begin, len);
+    memcpy(buffer, _read_buffer.get() + _read_buffer_begin, len);
+    _read_buffer_begin += len;
+    return len;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
 size_t stcp_socket::readsome( const std::shared_ptr<char>& buf, size_t len, size_t offset ) 
@@ -119,7 +135,6 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
     if (!_write_buffer)
       _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
     len = std::min<size_t>(write_buffer_length, len);
@@ -141,6 +156,60 @@ size_t stcp_socket::writesome( const std::shared_ptr<const char>& buf, size_t le
   return writesome(buf.get() + offset, len);
 }
 
+size_t stcp_socket::write_padded( std::initializer_list<std::pair<const char*, size_t>> buffers )
+{ try {
+#ifndef NDEBUG
+    // shares _write_buffer with writesome(), see there
+    struct check_buffer_in_use {
+      bool& _buffer_in_use;
+      check_buffer_in_use(bool& buffer_in_use) : _buffer_in_use(buffer_in_use) { assert(!_buffer_in_use); _buffer_in_use = true; }
+      ~check_buffer_in_use() { assert(_buffer_in_use); _buffer_in_use = false; }
+    } buffer_in_use_checker(_write_buffer_in_use);
+#endif
+
+    if (!_write_buffer)
+      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
+
+    size_t staged = 0;
+    size_t written = 0;
+    for( const auto& buffer : buffers )
+    {
+      const char* next = buffer.first;
+      size_t remaining = buffer.second;
+      while( remaining > 0 )
+      {
+        const size_t len = std::min<size_t>(write_buffer_length - staged, remaining);
+        memcpy(_write_buffer.get() + staged, next, len);
+        staged += len;
+        next += len;
+        remaining -= len;
+        if( staged == write_buffer_length )
+        {
+          encrypt_and_write_buffer(staged);
+          written += staged;
+          staged = 0;
+        }
+      }
+    }
+    if( staged > 0 )
+    {
+      const size_t staged_with_padding = 16 * ((staged + 15) / 16);
+      memset(_write_buffer.get() + staged, 0, staged_with_padding - staged);
+      encrypt_and_write_buffer(staged_with_padding);
+      written += staged_with_padding;
+    }
+    return written;
+} FC_RETHROW_EXCEPTIONS( warn, "" ) }
+
+void stcp_socket::encrypt_and_write_buffer( size_t len )
+{
+    assert( len > 0 && (len % 16) == 0 && len <= write_buffer_length );
+    // the cipher works on whole blocks, so encrypting in place is safe
+    uint32_t ciphertext_len = _send_aes.encode( _write_buffer.get(), len, _write_buffer.get() );
+    assert(ciphertext_len == len);
+    _sock.write( _write_buffer, ciphertext_len );
+}
+
 void stcp_socket::flush()
 {
   _sock.flush();
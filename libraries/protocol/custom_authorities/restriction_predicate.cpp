@@ -27,6 +27,11 @@
 #include "restriction_predicate.hxx"
 #include "sliced_lists.hxx"
 
+#include <fc/io/raw.hpp>
+
+#include <map>
+#include <mutex>
+
 namespace graphene { namespace protocol {
 
 restriction_predicate_function get_restriction_predicate(vector<restriction> rs, operation::tag_type op_type) {
@@ -69,6 +74,44 @@ restriction_predicate_function get_restriction_predicate(vector<restriction> rs,
    return [f=std::move(f)](const operation& op) { return f(op).reverse_path(); };
 }
 
+shared_restriction_predicate get_shared_restriction_predicate(const vector<restriction>& rs,
+                                                              operation::tag_type op_type) {
+   using key_type = std::pair<operation::tag_type, vector<char>>;
+   static std::mutex registry_mutex;
+   static std::map<key_type, std::weak_ptr<const restriction_predicate_function>> registry;
+   static size_t next_sweep_size = 64;
+
+   key_type key(op_type, fc::raw::pack(rs));
+   {
+      std::lock_guard<std::mutex> guard(registry_mutex);
+      auto itr = registry.find(key);
+      if (itr != registry.end())
+         if (auto predicate = itr->second.lock())
+            return predicate;
+   }
+
+   // Build it without holding the lock, it may take a while or throw on invalid restrictions
+   shared_restriction_predicate predicate =
+         std::make_shared<const restriction_predicate_function>(get_restriction_predicate(rs, op_type));
+
+   std::lock_guard<std::mutex> guard(registry_mutex);
+   auto& slot = registry[std::move(key)];
+   if (auto existing = slot.lock())
+      return existing;
+   slot = predicate;
+   // Forget the predicates nothing uses anymore once in a while
+   if (registry.size() >= next_sweep_size) {
+      for (auto itr = registry.begin(); itr != registry.end(); ) {
+         if (itr->second.expired())
+            itr = registry.erase(itr);
+         else
+            ++itr;
+      }
+      next_sweep_size = std::max<size_t>(64, registry.size() * 2);
+   }
+   return predicate;
+}
+
 predicate_result& predicate_result::reverse_path() {
    if (success)
       return *this;
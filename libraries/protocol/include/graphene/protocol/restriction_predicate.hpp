@@ -8,6 +8,7 @@
 #include <graphene/protocol/operations.hpp>
 
 #include <functional>
+#include <memory>
 
 namespace graphene { namespace protocol {
 
@@ -50,6 +51,21 @@ using restriction_predicate_function = std::function<predicate_result(const oper
  */
 restriction_predicate_function get_restriction_predicate(vector<restriction> rs, operation::tag_type op_type);
 
+/// A restriction predicate shared by everything restricting the same operation type with identical restrictions
+using shared_restriction_predicate = std::shared_ptr<const restriction_predicate_function>;
+
+/**
+ * @brief get_shared_restriction_predicate Get a predicate function for the supplied restriction, reusing the one
+ * built earlier for identical restrictions and operation type if it is still in use
+ * @param rs The restrictions to evaluate operations against
+ * @param op_type The tag specifying which operation type the restrictions apply to
+ * @return A predicate function which evaluates an operation to determine whether it complies with the restriction
+ *
+ * This function is thread safe.
+ */
+shared_restriction_predicate get_shared_restriction_predicate(const vector<restriction>& rs,
+                                                              operation::tag_type op_type);
+
 } } // namespace graphene::protocol
 
 FC_REFLECT_ENUM(graphene::protocol::predicate_result::rejection_reason,
@@ -10,6 +10,39 @@ namespace graphene { namespace protocol {
    using custom_authority_lookup = std::function<vector<authority>(account_id_type, const operation&,
                                                                    rejected_predicate_map*)>;
 
+   /// What the outcome of verifying the authorities of operations depends on, besides the authorities themselves
+   struct authority_check_key
+   {
+      flat_set<account_id_type> required_active;
+      flat_set<account_id_type> required_owner;
+      flat_set<public_key_type> keys;
+      bool                      allow_non_immediate_owner = false;
+      uint32_t                  max_recursion = 0;
+
+      friend bool operator < ( const authority_check_key& a, const authority_check_key& b )
+      {
+         return std::tie( a.required_active, a.required_owner, a.keys, a.allow_non_immediate_owner, a.max_recursion )
+              < std::tie( b.required_active, b.required_owner, b.keys, b.allow_non_immediate_owner, b.max_recursion );
+      }
+   };
+
+   /**
+    * @brief Remembers keys that satisfied the authorities of accounts
+    *
+    * verify_authority() only consults it when the operations need nothing but active and owner authorities of
+    * accounts, no custom authority applies and no approvals are given.  The outcome then only depends on the
+    * @ref authority_check_key and on the authorities of the accounts read while verifying.
+    */
+   class authority_check_cache
+   {
+   public:
+      virtual ~authority_check_cache() = default;
+      /// @return whether the keys satisfied the authorities before and none of the authorities read changed since
+      virtual bool satisfied( const authority_check_key& key ) = 0;
+      /// Remembers that the keys satisfied the authorities, reading the authorities of @p accounts_read
+      virtual void add( authority_check_key&& key, const flat_set<account_id_type>& accounts_read ) = 0;
+   };
+
    /**
     * @defgroup transactions Transactions
     *
@@ -152,6 +185,7 @@ namespace graphene { namespace protocol {
        *            required_auths field of custom_operation or not
        * @param max_recursion maximum level of recursion when verifying, since an account
        *            can have another account in active authorities and/or owner authorities
+       * @param cache outcomes of earlier verifications to reuse, may be null
        */
       void verify_authority(
               const chain_id_type& chain_id,
@@ -160,7 +194,8 @@ namespace graphene { namespace protocol {
               const custom_authority_lookup& get_custom,
               bool allow_non_immediate_owner,
               bool ignore_custom_operation_required_auths,
-              uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH )const;
+              uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH,
+              authority_check_cache* cache = nullptr )const;
 
       /**
        * This is a slower replacement for get_required_signatures()
@@ -242,6 +277,7 @@ namespace graphene { namespace protocol {
     * @param allow_committee whether to allow the special "committee account" to authorize the operations
     * @param active_approvals accounts that approved the operations with their active authories
     * @param owner_approvals accounts that approved the operations with their owner authories
+    * @param cache outcomes of earlier verifications to reuse, may be null
     */
    void verify_authority( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
                           const std::function<const authority*(account_id_type)>& get_active,
@@ -252,7 +288,8 @@ namespace graphene { namespace protocol {
                           uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH,
                           bool allow_committee = false,
                           const flat_set<account_id_type>& active_approvals = flat_set<account_id_type>(),
-                          const flat_set<account_id_type>& owner_approvals = flat_set<account_id_type>() );
+                          const flat_set<account_id_type>& owner_approvals = flat_set<account_id_type>(),
+                          authority_check_cache* cache = nullptr );
 
    /**
     *  @brief captures the result of evaluating the operations contained in the transaction
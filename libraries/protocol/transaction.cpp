@@ -253,7 +253,8 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
                        uint32_t max_recursion_depth,
                        bool  allow_committee,
                        const flat_set<account_id_type>& active_aprovals,
-                       const flat_set<account_id_type>& owner_approvals )
+                       const flat_set<account_id_type>& owner_approvals,
+                       authority_check_cache* cache )
 {
    rejected_predicate_map rejected_custom_auths;
    try {
@@ -261,16 +262,34 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
    flat_set<account_id_type> required_owner;
    vector<authority> other;
 
-   sign_state s( sigs, get_active, get_owner, allow_non_immediate_owner, max_recursion_depth );
+   // With a cache, remember whose authorities are read
+   if( cache != nullptr && ( !active_aprovals.empty() || !owner_approvals.empty() ) )
+      cache = nullptr;
+   flat_set<account_id_type> accounts_read;
+   const std::function<const authority*(account_id_type)> read_active = [&]( account_id_type id ) {
+      accounts_read.insert( id );
+      return get_active( id );
+   };
+   const std::function<const authority*(account_id_type)> read_owner = [&]( account_id_type id ) {
+      accounts_read.insert( id );
+      return get_owner( id );
+   };
+
+   sign_state s( sigs, cache != nullptr ? read_active : get_active, cache != nullptr ? read_owner : get_owner,
+                 allow_non_immediate_owner, max_recursion_depth );
    for( auto& id : active_aprovals )
       s.approved_by.insert( id );
    for( auto& id : owner_approvals )
       s.approved_by.insert( id );
 
-   auto approved_by_custom_authority = [&s, &rejected_custom_auths, get_custom = std::move(get_custom)](
+   bool custom_authority_applied = false;
+   auto approved_by_custom_authority = [&s, &rejected_custom_auths, &custom_authority_applied,
+                                        get_custom = std::move(get_custom)](
            account_id_type account,
            operation op ) mutable {
       auto viable_custom_auths = get_custom( account, op, &rejected_custom_auths );
+      if( !viable_custom_auths.empty() )
+         custom_authority_applied = true;
       for( const auto& auth : viable_custom_auths )
          if( s.check_authority( &auth ) ) return true;
       return false;
@@ -296,6 +315,16 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
       GRAPHENE_ASSERT( required_active.find(GRAPHENE_COMMITTEE_ACCOUNT) == required_active.end(),
                        invalid_committee_approval, "Committee account may only propose transactions" );
 
+   // Without custom and other authorities, the outcome only depends on the cache key and the authorities read
+   optional<authority_check_key> cache_key;
+   if( cache != nullptr && !custom_authority_applied && other.empty() )
+   {
+      cache_key = authority_check_key{ required_active, required_owner, sigs, allow_non_immediate_owner,
+                                       max_recursion_depth };
+      if( cache->satisfied( *cache_key ) )
+         return;
+   }
+
    for( const auto& auth : other )
    {
       GRAPHENE_ASSERT( s.check_authority(&auth), tx_missing_other_auth, "Missing Authority", ("auth",auth)("sigs",sigs) );
@@ -322,6 +351,9 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
       tx_irrelevant_sig,
       "Unnecessary signature(s) detected"
       );
+
+   if( cache_key.valid() )
+      cache->add( std::move( *cache_key ), accounts_read );
 } FC_CAPTURE_AND_RETHROW( (rejected_custom_auths)(ops)(sigs) ) }
 
 
@@ -445,11 +477,13 @@ void signed_transaction::verify_authority( const chain_id_type& chain_id,
                                            const custom_authority_lookup& get_custom,
                                            bool allow_non_immediate_owner,
                                            bool ignore_custom_operation_required_auths,
-                                           uint32_t max_recursion )const
+                                           uint32_t max_recursion,
+                                           authority_check_cache* cache )const
 { try {
    graphene::protocol::verify_authority( operations, get_signature_keys( chain_id ), get_active, get_owner,
                                          get_custom, allow_non_immediate_owner,
-                                         ignore_custom_operation_required_auths, max_recursion );
+                                         ignore_custom_operation_required_auths, max_recursion,
+                                         false, flat_set<account_id_type>(), flat_set<account_id_type>(), cache );
 } FC_CAPTURE_AND_RETHROW( (*this) ) }
 
 } } // graphene::protocol
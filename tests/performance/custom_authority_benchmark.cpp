@@ -0,0 +1,94 @@
+/*
+ * Acloudbank
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/protocol/restriction_predicate.hpp>
+#include <graphene/protocol/transfer.hpp>
+
+#include <fc/time.hpp>
+
+using namespace graphene::protocol;
+
+namespace {
+   template<typename Object>
+   unsigned_int member_index( const string& name )
+   {
+      unsigned_int index;
+      fc::typelist::runtime::for_each( typename fc::reflector<Object>::native_members(), [&name, &index]( auto t ) {
+         if( name == decltype(t)::type::get_name() )
+            index = decltype(t)::type::index;
+      });
+      return index;
+   }
+}
+
+/// Time of building and evaluating restriction predicates of common shapes on a transfer they accept
+BOOST_AUTO_TEST_CASE( custom_authority_benchmark )
+{ try {
+   const uint32_t num_evaluations = 1000000;
+   const uint32_t num_builds = 10000;
+   const auto transfer_tag = operation::tag<transfer_operation>::value;
+
+   const auto to_index = member_index<transfer_operation>( "to" );
+   const auto amount_index = member_index<transfer_operation>( "amount" );
+   const auto asset_id_index = member_index<asset>( "asset_id" );
+   const auto asset_amount_index = member_index<asset>( "amount" );
+
+   flat_set<account_id_type> whitelist;
+   for( uint64_t i = 100; i < 200; ++i )
+      whitelist.insert( account_id_type( i ) );
+
+   vector<std::pair<string, vector<restriction>>> shapes;
+   shapes.emplace_back( "recipient", vector<restriction>{
+         restriction( to_index, restriction::func_eq, account_id_type( 150 ) ) } );
+   shapes.emplace_back( "amount cap", vector<restriction>{
+         restriction( amount_index, restriction::func_attr, vector<restriction>{
+               restriction( asset_id_index, restriction::func_eq, asset_id_type() ),
+               restriction( asset_amount_index, restriction::func_le, int64_t( 1000 ) ) } ) } );
+   shapes.emplace_back( "recipient whitelist", vector<restriction>{
+         restriction( to_index, restriction::func_in, whitelist ) } );
+   shapes.emplace_back( "either recipient", vector<restriction>{
+         restriction( to_index, restriction::func_logical_or, vector<vector<restriction>>{
+               { restriction( to_index, restriction::func_eq, account_id_type( 149 ) ) },
+               { restriction( to_index, restriction::func_eq, account_id_type( 150 ) ) } } ) } );
+
+   transfer_operation transfer;
+   transfer.to = account_id_type( 150 );
+   transfer.amount = asset( 500 );
+   const operation op = transfer;
+
+   for( const auto& shape : shapes )
+   {
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < num_builds; ++i )
+         get_restriction_predicate( shape.second, transfer_tag );
+      auto build_time = fc::time_point::now() - start;
+
+      const restriction_predicate_function predicate = get_restriction_predicate( shape.second, transfer_tag );
+      uint32_t accepted = 0;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < num_evaluations; ++i )
+      {
+         restriction_predicate_function copy = predicate; // what evaluating a custom authority used to cost
+         accepted += copy( op ).success;
+      }
+      auto copied_time = fc::time_point::now() - start;
+      BOOST_CHECK_EQUAL( accepted, num_evaluations );
+
+      const shared_restriction_predicate shared = get_shared_restriction_predicate( shape.second, transfer_tag );
+      BOOST_CHECK( get_shared_restriction_predicate( shape.second, transfer_tag ) == shared );
+      accepted = 0;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < num_evaluations; ++i )
+         accepted += (*shared)( op ).success;
+      auto shared_time = fc::time_point::now() - start;
+      BOOST_CHECK_EQUAL( accepted, num_evaluations );
+
+      ilog( "${shape}: build ${b}us, evaluate with copy ${c}ns, evaluate shared ${s}ns",
+            ("shape", shape.first)
+            ("b", double( build_time.count() ) / num_builds)
+            ("c", double( copied_time.count() ) * 1000 / num_evaluations)
+            ("s", double( shared_time.count() ) * 1000 / num_evaluations) );
+   }
+} FC_LOG_AND_RETHROW() }
@@ -0,0 +1,64 @@
+/*
+ * Acloudbank
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/time.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+/// Time of database::generate_block() depending on the number of pending transactions
+BOOST_FIXTURE_TEST_CASE( generate_block_benchmark, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+
+   const std::vector<uint32_t> depths = { 100, 1000, 5000, 10000 };
+   const uint32_t runs_per_depth = 2; // one without and one with re-application of the pending transactions
+
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset( 1 );
+   op.fee = db.current_fee_schedule().calculate_fee( op );
+   uint64_t total_transfers = 0;
+   for( uint32_t depth : depths )
+      total_transfers += depth * runs_per_depth;
+   // amounts differ to keep the transaction IDs unique
+   fund( alice, asset( ( op.fee.amount.value + int64_t(total_transfers) ) * int64_t(total_transfers) ) );
+   generate_block();
+
+   uint64_t amount = 0;
+   for( uint32_t depth : depths )
+   {
+      for( uint32_t run = 0; run < runs_per_depth; ++run )
+      {
+         trx.clear();
+         test::set_expiration( db, trx );
+         for( uint32_t i = 0; i < depth; ++i )
+         {
+            op.amount = asset( int64_t( ++amount ) );
+            trx.operations.push_back( op );
+            db.push_transaction( trx, ~0 );
+            trx.operations.clear();
+         }
+
+         // Transactions pushed with checks skipped that the block producer does not skip have to be applied again
+         const bool reapply = ( run == 1 );
+         const uint32_t skip = reapply ? ( ~0u & ~database::skip_transaction_dupe_check ) : ~0u;
+
+         auto start = fc::time_point::now();
+         const signed_block block = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1),
+                                                       init_account_priv_key, skip );
+         auto elapsed = fc::time_point::now() - start;
+
+         wlog( "Generated a block of ${n} out of ${d} pending transfers in ${t}ms (${mode})",
+               ("n",block.transactions.size())("d",depth)("t",double(elapsed.count())/1000)
+               ("mode", reapply ? "re-applied" : "pending state kept") );
+      }
+   }
+} FC_LOG_AND_RETHROW() }
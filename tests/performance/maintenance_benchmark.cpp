@@ -0,0 +1,78 @@
+/*
+ * Acloudbank
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/committee_member_object.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/witness_object.hpp>
+
+#include <fc/time.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+/// Time of a maintenance interval with 1M voting accounts, a quarter of which vote by proxy
+BOOST_FIXTURE_TEST_CASE( maintenance_benchmark, database_fixture )
+{ try {
+   generate_blocks( HARDFORK_CORE_2262_TIME );
+   generate_block();
+
+   const uint32_t num_accounts = 1000000;
+   const uint32_t proxy_every = 4; // every fourth account lets the account before it vote
+
+   const vote_id_type witness_vote = witness_id_type(1)(db).vote_id;
+   const vote_id_type committee_vote = committee_member_id_type(0)(db).vote_id;
+
+   const time_point_sec now = db.head_block_time();
+   uint64_t expected_votes = 0;
+   auto start = fc::time_point::now();
+   account_id_type proxy = GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+   for( uint32_t i = 0; i < num_accounts; ++i )
+   {
+      const string name = "voter" + fc::to_string( i );
+      const bool by_proxy = ( i % proxy_every == proxy_every - 1 );
+      const account_object& account = db.create<account_object>( [&]( account_object& a ) {
+         a.name = name;
+         a.registrar = a.referrer = a.lifetime_referrer = GRAPHENE_COMMITTEE_ACCOUNT;
+         a.membership_expiration_date = time_point_sec::maximum();
+         a.options.voting_account = by_proxy ? proxy : GRAPHENE_PROXY_TO_SELF_ACCOUNT;
+         if( !by_proxy )
+         {
+            a.options.votes = { witness_vote, committee_vote };
+            a.options.num_witness = 1;
+            a.options.num_committee = 1;
+         }
+         a.num_committee_voted = by_proxy ? 0 : 1;
+      });
+      // after core-2262 the balances do not vote, the core in open orders still does
+      const account_statistics_object& stats = db.create<account_statistics_object>(
+            [&account,&name,&now,i]( account_statistics_object& s ) {
+         s.owner = account.get_id();
+         s.name = name;
+         s.is_voting = true;
+         s.total_core_in_orders = 1000 + i;
+         s.last_vote_time = now; // full voting power
+      });
+      expected_votes += 1000 + i;
+      db.modify( account, [&stats]( account_object& a ) {
+         a.statistics = stats.get_id();
+      });
+      proxy = account.get_id();
+   }
+   auto elapsed = fc::time_point::now() - start;
+   wlog( "Created ${n} voting accounts in ${t}ms", ("n",num_accounts)("t",double(elapsed.count())/1000) );
+
+   start = fc::time_point::now();
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   elapsed = fc::time_point::now() - start;
+   wlog( "Generated the maintenance block with ${n} voting accounts in ${t}ms",
+         ("n",num_accounts)("t",double(elapsed.count())/1000) );
+
+   // all accounts vote for the same witness and committee member, directly or by proxy
+   BOOST_CHECK_EQUAL( witness_id_type(1)(db).total_votes, expected_votes );
+   BOOST_CHECK_EQUAL( committee_member_id_type(0)(db).total_votes, expected_votes );
+} FC_LOG_AND_RETHROW() }
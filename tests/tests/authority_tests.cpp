@@ -293,6 +293,94 @@ BOOST_AUTO_TEST_CASE( recursive_accounts )
    }
 }
 
+BOOST_AUTO_TEST_CASE( authority_cache )
+{
+   try {
+      fc::ecc::private_key parent1_key = fc::ecc::private_key::generate();
+      fc::ecc::private_key parent2_key = fc::ecc::private_key::generate();
+      const auto& core = asset_id_type()(db);
+      const account_object& parent1 = create_account("parent1", parent1_key.get_public_key());
+      const account_object& parent2 = create_account("parent2", parent2_key.get_public_key());
+      {
+         auto make_child_op = make_account("child");
+         make_child_op.owner = authority(2, account_id_type(parent1.id), 1, account_id_type(parent2.id), 1);
+         make_child_op.active = authority(2, account_id_type(parent1.id), 1, account_id_type(parent2.id), 1);
+         trx.operations.push_back(make_child_op);
+         PUSH_TX( db, trx, ~0 );
+         trx.operations.clear();
+      }
+      const account_object& child = get_account("child");
+      fund(child);
+      account_authority_cache& cache = *db.get_authority_cache();
+
+      transfer_operation op;
+      op.from = child.id;
+      op.amount = core.amount(10);
+      trx.operations.push_back(op);
+      sign(trx, parent1_key);
+      sign(trx, parent2_key);
+      const size_t cached = cache.size();
+      PUSH_TX( db, trx, database::skip_transaction_dupe_check );
+      BOOST_CHECK_EQUAL( cache.size(), cached + 1 );
+
+      BOOST_TEST_MESSAGE( "The same keys and accounts again are found in the cache" );
+      PUSH_TX( db, trx, database::skip_transaction_dupe_check );
+      BOOST_CHECK_EQUAL( cache.size(), cached + 1 );
+
+      BOOST_TEST_MESSAGE( "An extra signature is still rejected" );
+      fc::ecc::private_key other_key = fc::ecc::private_key::generate();
+      sign(trx, other_key);
+      GRAPHENE_CHECK_THROW(PUSH_TX( db, trx, database::skip_transaction_dupe_check ), fc::exception);
+      trx.clear();
+
+      BOOST_TEST_MESSAGE( "Replacing the key of a parent makes the old key fail" );
+      fc::ecc::private_key new_parent1_key = fc::ecc::private_key::generate();
+      {
+         account_update_operation uop;
+         uop.account = parent1.id;
+         uop.active = authority(1, public_key_type(new_parent1_key.get_public_key()), 1);
+         trx.operations.push_back(uop);
+         sign(trx, parent1_key);
+         PUSH_TX( db, trx, database::skip_transaction_dupe_check );
+         trx.clear();
+      }
+      trx.operations.push_back(op);
+      sign(trx, parent1_key);
+      sign(trx, parent2_key);
+      GRAPHENE_CHECK_THROW(PUSH_TX( db, trx, database::skip_transaction_dupe_check ), fc::exception);
+      trx.clear_signatures();
+      sign(trx, new_parent1_key);
+      sign(trx, parent2_key);
+      PUSH_TX( db, trx, database::skip_transaction_dupe_check );
+      trx.clear();
+
+      BOOST_TEST_MESSAGE( "Undoing a key change invalidates what was cached meanwhile" );
+      auto verify = [this,&cache]( const signed_transaction& tx ) {
+         tx.verify_authority( db.get_chain_id(),
+                              [this]( account_id_type id ) { return &id(db).active; },
+                              [this]( account_id_type id ) { return &id(db).owner; },
+                              []( account_id_type, const operation&, rejected_predicate_map* ) {
+                                 return vector<authority>(); },
+                              true, false, GRAPHENE_MAX_SIG_CHECK_DEPTH, &cache );
+      };
+      trx.operations.push_back(op);
+      sign(trx, parent1_key);
+      sign(trx, parent2_key);
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify( parent1, [&parent1_key]( account_object& a ) {
+            a.active = authority(1, public_key_type(parent1_key.get_public_key()), 1);
+         });
+         verify( trx );
+         verify( trx );
+         session.undo();
+      }
+      GRAPHENE_CHECK_THROW( verify( trx ), fc::exception );
+      trx.clear();
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( proposed_single_account )
 {
    using namespace graphene::chain;
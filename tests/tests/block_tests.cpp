@@ -38,6 +38,9 @@
 
 #include <graphene/utilities/tempdir.hpp>
 
+#include <atomic>
+#include <thread>
+
 #include <fc/crypto/digest.hpp>
 #include <fc/io/fstream.hpp>
 
@@ -133,6 +136,94 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( segmented_block_database_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      const uint32_t num_blocks = 12000; // beyond the blocks used to build the compression dictionary
+      clearable_block b;
+      {
+         block_database bdb;
+         bdb.set_layout_for_new_log( 1000, true );
+         bdb.open( data_dir.path() );
+         for( uint32_t i = 0; i < num_blocks; ++i )
+         {
+            if( i > 0 ) b.previous = b.id();
+            b.witness = witness_id_type(i+1);
+            b.clear();
+            bdb.store( b.id(), b );
+         }
+         BOOST_CHECK( fc::exists( data_dir.path() / "blocks.11" ) );
+         BOOST_CHECK( fc::exists( data_dir.path() / "dictionary" ) );
+      }
+
+      // the layout of an existing log is kept
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      auto last = bdb.last();
+      BOOST_REQUIRE( last.valid() );
+      BOOST_CHECK( last->id() == b.id() );
+      for( uint32_t i = 1; i <= num_blocks; i += 97 )
+      {
+         auto blk = bdb.fetch_by_number( i );
+         BOOST_REQUIRE( blk.valid() );
+         BOOST_CHECK( blk->witness == witness_id_type(i) );
+         BOOST_CHECK( bdb.contains( blk->id() ) );
+      }
+      BOOST_CHECK( !bdb.fetch_by_number( num_blocks + 1 ).valid() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_concurrent_read_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      const uint32_t num_blocks = 2000;
+      std::atomic<uint32_t> stored( 0 );
+      std::atomic<bool> failed( false );
+      std::vector< std::thread > readers;
+      // readers fetch the blocks known to be stored while the files keep growing
+      for( int r = 0; r < 4; ++r )
+         readers.emplace_back( [&bdb,&stored,&failed]() {
+            while( stored.load() < num_blocks )
+            {
+               const uint32_t n = stored.load();
+               for( uint32_t i = 1; i <= n; i += 7 )
+               {
+                  auto blk = bdb.fetch_by_number( i );
+                  if( !blk.valid() || blk->witness != witness_id_type(i) || !bdb.contains( blk->id() ) )
+                     failed = true;
+               }
+            }
+         });
+
+      clearable_block b;
+      for( uint32_t i = 0; i < num_blocks; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         stored = i + 1;
+      }
+      for( auto& t : readers )
+         t.join();
+      BOOST_CHECK( !failed );
+      BOOST_CHECK( bdb.fetch_block_id( num_blocks ) == b.id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -1861,6 +1952,139 @@ BOOST_FIXTURE_TEST_CASE( temp_account_balance, database_fixture )
    BOOST_CHECK( get_balance( GRAPHENE_TEMP_ACCOUNT, asset_id_type() ) > 0 );
 } FC_LOG_AND_RETHROW() }
 
+BOOST_FIXTURE_TEST_CASE( generate_block_keeps_pending_order, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   generate_block();
+
+   std::vector<transaction_id_type> ids;
+   size_t trx_size = 0; // in a block, without operation results
+   for( int64_t i = 1; i <= 5; ++i )
+   {
+      transfer_operation top;
+      top.from = alice_id;
+      top.to = bob_id;
+      top.amount = asset( i );
+      trx.operations.push_back( top );
+      set_expiration( db, trx );
+      sign( trx, alice_private_key );
+      ids.push_back( PUSH_TX( db, trx ).id() );
+      trx_size = fc::raw::pack_size( trx ) + fc::raw::pack_size( vector<operation_result>() );
+      trx.clear();
+   }
+
+   // room for two transfers per block
+   const auto& gpo = db.get_global_properties();
+   db._undo_db.disable();
+   db.modify( gpo, [trx_size]( global_property_object& p ) {
+      p.parameters.maximum_block_size = fc::raw::pack_size( signed_block_header() ) + 3 + 2 * trx_size + 10;
+   });
+   db._undo_db.enable();
+
+   std::vector<transaction_id_type> included;
+   for( int i = 0; i < 3; ++i )
+   {
+      const signed_block block = generate_block();
+      BOOST_CHECK_LE( block.transactions.size(), 2u );
+      for( const auto& t : block.transactions )
+         included.push_back( t.id() );
+   }
+   BOOST_CHECK( included == ids );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( transaction_pool_priority_and_limits, database_fixture )
+{ try {
+   ACTORS( (alice)(bob)(carol) );
+   fund( alice );
+   fund( carol );
+   generate_block();
+
+   size_t trx_size = 0; // in a block, without operation results
+   auto push_transfer = [&]( const account_id_type& from, const fc::ecc::private_key& key, int64_t fee_factor ) {
+      static int64_t amount = 0;
+      transfer_operation top;
+      top.from = from;
+      top.to = bob_id;
+      top.amount = asset( ++amount );
+      const int64_t required_fee = db.current_fee_schedule().calculate_fee( top ).amount.value;
+      top.fee = asset( std::max<int64_t>( required_fee, 100 ) * fee_factor );
+      trx.operations.push_back( top );
+      set_expiration( db, trx );
+      sign( trx, key );
+      transaction_id_type id = PUSH_TX( db, trx ).id();
+      trx_size = fc::raw::pack_size( trx ) + fc::raw::pack_size( vector<operation_result>() );
+      trx.clear();
+      return id;
+   };
+
+   BOOST_TEST_MESSAGE( "Limit the pending transactions per fee paying account" );
+   db.set_max_pending_transactions_per_account( 2 );
+   const transaction_id_type low1 = push_transfer( alice_id, alice_private_key, 1 );
+   const transaction_id_type low2 = push_transfer( alice_id, alice_private_key, 1 );
+   GRAPHENE_REQUIRE_THROW( push_transfer( alice_id, alice_private_key, 1 ), fc::exception );
+   trx.clear();
+   db.set_max_pending_transactions_per_account( 0 );
+
+   BOOST_TEST_MESSAGE( "A late transaction paying a higher fee goes first when the block is full" );
+   const transaction_id_type high = push_transfer( carol_id, carol_private_key, 10 );
+
+   // room for one transfer per block
+   const auto& gpo = db.get_global_properties();
+   db._undo_db.disable();
+   db.modify( gpo, [trx_size]( global_property_object& p ) {
+      p.parameters.maximum_block_size = fc::raw::pack_size( signed_block_header() ) + 3 + trx_size + 10;
+   });
+   db._undo_db.enable();
+
+   std::vector<transaction_id_type> included;
+   for( int i = 0; i < 3; ++i )
+   {
+      const signed_block block = generate_block();
+      BOOST_REQUIRE_EQUAL( block.transactions.size(), 1u );
+      included.push_back( block.transactions.front().id() );
+   }
+   BOOST_CHECK( included == std::vector<transaction_id_type>( { high, low1, low2 } ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE( push_transactions_batch, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+   fund( alice );
+   generate_block();
+
+   vector<precomputable_transaction> trxs;
+   for( int64_t i = 1; i <= 3; ++i )
+   {
+      transfer_operation top;
+      top.from = alice_id;
+      top.to = bob_id;
+      top.amount = asset( i );
+      trx.operations.push_back( top );
+      set_expiration( db, trx );
+      sign( trx, ( i == 2 ) ? bob_private_key : alice_private_key );
+      trxs.push_back( trx );
+      trx.clear();
+   }
+   trxs.push_back( trxs.front() );
+
+   db.precompute_parallel( trxs ).wait();
+   const vector<fc::oexception> results = db.push_transactions( trxs );
+
+   // the transfer signed by the wrong key and the duplicate are rejected, the others are pending in order
+   BOOST_REQUIRE_EQUAL( results.size(), 4u );
+   BOOST_CHECK( !results[0].valid() );
+   BOOST_CHECK( results[1].valid() );
+   BOOST_CHECK( !results[2].valid() );
+   BOOST_REQUIRE( results[3].valid() );
+   BOOST_CHECK_EQUAL( results[3]->code(), duplicate_transaction::code_enum::code_value );
+
+   const signed_block block = generate_block();
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), 2u );
+   BOOST_CHECK( block.transactions[0].id() == trxs[0].id() );
+   BOOST_CHECK( block.transactions[1].id() == trxs[2].id() );
+} FC_LOG_AND_RETHROW() }
+
 ///
 /// This test case tries to
 /// * generate blocks when there are too many pending transactions,
@@ -415,6 +415,30 @@ BOOST_AUTO_TEST_CASE(restriction_predicate_tests) { try {
    BOOST_CHECK(predicate(update) == true);
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(shared_restriction_predicates) { try {
+   using namespace graphene::protocol;
+   auto to_index = member_index<transfer_operation>("to");
+   vector<restriction> to_12 = {restriction(to_index, FUNC(eq), account_id_type(12))};
+   vector<restriction> to_13 = {restriction(to_index, FUNC(eq), account_id_type(13))};
+   const auto transfer_tag = operation::tag<transfer_operation>::value;
+
+   // Identical restrictions share one predicate while it is in use
+   auto predicate = get_shared_restriction_predicate(to_12, transfer_tag);
+   BOOST_CHECK(get_shared_restriction_predicate(to_12, transfer_tag) == predicate);
+   BOOST_CHECK(get_shared_restriction_predicate(to_13, transfer_tag) != predicate);
+   BOOST_CHECK(get_shared_restriction_predicate(to_12, operation::tag<override_transfer_operation>::value)
+               != predicate);
+
+   transfer_operation transfer;
+   transfer.to = account_id_type(12);
+   BOOST_CHECK((*predicate)(transfer) == true);
+   BOOST_CHECK((*get_shared_restriction_predicate(to_13, transfer_tag))(transfer) == false);
+
+   // Invalid restrictions are rejected as when building a predicate of one's own
+   vector<restriction> invalid = {restriction(unsigned_int(100), FUNC(eq), account_id_type(12))};
+   BOOST_CHECK_THROW(get_shared_restriction_predicate(invalid, transfer_tag), fc::assert_exception);
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(container_in_not_in_checks) { try {
    vector<restriction> restrictions;
    restrictions.emplace_back(member_index<asset_update_feed_producers_operation>("new_feed_producers"), FUNC(in),
@@ -28,6 +28,9 @@
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/withdraw_permission_object.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 
@@ -119,6 +122,411 @@ BOOST_AUTO_TEST_CASE( flat_index_test )
    BOOST_CHECK( !(*bitusd_id(db).bitasset_data_id)(db).current_feed.settlement_price.is_null() );
 } FC_CAPTURE_AND_RETHROW() }
 
+namespace {
+   /// Creates @p count balances in a committed undo state, enough of them to make modified copies worth compacting
+   std::vector<account_balance_id_type> create_balances( database& db, size_t count )
+   {
+      std::vector<account_balance_id_type> ids;
+      auto ses = db._undo_db.start_undo_session();
+      for( size_t i = 0; i < count; ++i )
+         ids.push_back( db.create<account_balance_object>( []( account_balance_object& obj ){
+             obj.balance = 42;
+         }).get_id() );
+      ses.commit();
+      return ids;
+   }
+
+   void set_balances( database& db, const std::vector<account_balance_id_type>& ids, int64_t balance )
+   {
+      for( const auto& id : ids )
+         db.modify( id(db), [balance]( account_balance_object& obj ){ obj.balance = balance; } );
+   }
+}
+
+BOOST_AUTO_TEST_CASE( delta_undo_test )
+{
+   try {
+      database db;
+      const auto ids = create_balances( db, 2000 );
+      const account_balance_id_type bal_id = ids.front();
+      {
+         auto ses = db._undo_db.start_undo_session();
+         set_balances( db, ids, 100 );
+         ses.commit();
+      }
+      // the committed state keeps the modified balances as deltas only
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_values.size(), 0u );
+      BOOST_REQUIRE_EQUAL( db._undo_db.head().old_deltas.size(), ids.size() );
+      BOOST_CHECK( !db._undo_db.head().old_deltas.begin()->second.full );
+
+      // a later change outside of a session must not break the delta
+      db.modify( bal_id(db), []( account_balance_object& obj ){
+          obj.balance = 7;
+      });
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_deltas.size(), ids.size() - 1 );
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_values.size(), 1u );
+
+      db.pop_undo();
+      BOOST_CHECK_EQUAL( bal_id(db).balance.value, 42 );
+      BOOST_CHECK_EQUAL( ids.back()(db).balance.value, 42 );
+
+      // undo deltas directly
+      {
+         auto ses = db._undo_db.start_undo_session();
+         set_balances( db, ids, 1000000 );
+         ses.commit();
+      }
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_deltas.size(), ids.size() );
+      db.pop_undo();
+      BOOST_CHECK_EQUAL( bal_id(db).balance.value, 42 );
+      BOOST_CHECK_EQUAL( ids.back()(db).balance.value, 42 );
+
+      // a small state is not worth compacting and keeps its copy
+      {
+         auto ses = db._undo_db.start_undo_session();
+         set_balances( db, { bal_id }, 5 );
+         ses.commit();
+      }
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_deltas.size(), 0u );
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_values.size(), 1u );
+      db.pop_undo();
+      BOOST_CHECK_EQUAL( bal_id(db).balance.value, 42 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( delta_undo_merge_test )
+{
+   try {
+      database db;
+      const auto ids = create_balances( db, 2000 );
+      const account_balance_id_type bal_id = ids.front();
+      {
+         auto ses = db._undo_db.start_undo_session();
+         set_balances( db, ids, 100 );
+         ses.commit();
+      }
+      BOOST_REQUIRE_EQUAL( db._undo_db.head().old_deltas.size(), ids.size() );
+
+      // merging a later change into the compacted state must not leave a delta against the old value
+      {
+         auto ses = db._undo_db.start_undo_session();
+         db.modify( bal_id(db), []( account_balance_object& obj ){
+             obj.balance = 7;
+         });
+         ses.merge();
+      }
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_deltas.size(), ids.size() - 1 );
+      BOOST_CHECK_EQUAL( db._undo_db.head().old_values.size(), 1u );
+      BOOST_CHECK_EQUAL( bal_id(db).balance.value, 7 );
+
+      db.pop_undo();
+      BOOST_CHECK_EQUAL( bal_id(db).balance.value, 42 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( dense_index_test )
+{
+   try {
+      database db;
+      const auto& bal_idx = db.get_index_type<account_balance_index>();
+      std::vector<account_balance_id_type> ids;
+      for( int64_t i = 0; i < 3000; ++i )
+      {
+         ids.push_back( db.create<account_balance_object>( [i]( account_balance_object& obj ){
+            obj.owner = account_id_type( i );
+            obj.balance = i;
+         }).get_id() );
+      }
+      BOOST_CHECK_EQUAL( bal_idx.indices().size(), 3000u );
+      BOOST_CHECK_EQUAL( ids[1234](db).balance.value, 1234 );
+
+      // secondary indices follow modifications
+      db.modify( ids[10](db), []( account_balance_object& obj ){ obj.balance = 100000; } );
+      const auto& by_balance = bal_idx.indices().get<by_asset_balance>();
+      BOOST_CHECK( by_balance.begin()->id == ids[10] );
+
+      // removing a whole chunk releases it, iteration skips the gap
+      for( size_t i = 1024; i < 2048; ++i )
+         db.remove( ids[i](db) );
+      BOOST_CHECK( db.find( ids[1500] ) == nullptr );
+      BOOST_CHECK_EQUAL( bal_idx.indices().size(), 2000u );
+      size_t count = 0;
+      for( const account_balance_object& obj : bal_idx.indices() )
+      {
+         BOOST_CHECK( obj.id.instance() < 1024 || obj.id.instance() >= 2048 );
+         ++count;
+      }
+      BOOST_CHECK_EQUAL( count, 2000u );
+      BOOST_CHECK_EQUAL( by_balance.size(), 2000u );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( checkpoint_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      account_balance_id_type kept;
+      account_balance_id_type removed;
+      {
+         database db;
+         db.enable_checkpoints( 2 );
+         db.object_database::open( data_dir.path() );
+         kept = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 1; } ).get_id();
+         removed = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 2; } ).get_id();
+         db.checkpoint();
+         BOOST_CHECK( fc::exists( data_dir.path() / "object_database" / "checkpoints" / "0" ) );
+
+         db.modify( kept(db), []( account_balance_object& obj ){ obj.balance = 77; } );
+         db.remove( removed(db) );
+         db.checkpoint();
+         BOOST_CHECK( fc::exists( data_dir.path() / "object_database" / "checkpoints" / "1" ) );
+         // no flush, as after a crash
+      }
+      {
+         database db;
+         db.enable_checkpoints( 2 );
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( kept(db).balance.value, 77 );
+         BOOST_CHECK( db.find( removed ) == nullptr );
+         BOOST_CHECK( db.get_index_type<account_balance_index>().get_next_id() == object_id_type( removed ) + 1 );
+
+         // the maximum number of segments is reached, the next checkpoint writes everything
+         db.modify( kept(db), []( account_balance_object& obj ){ obj.balance = 78; } );
+         db.checkpoint();
+         BOOST_CHECK( !fc::exists( data_dir.path() / "object_database" / "checkpoints" ) );
+      }
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( kept(db).balance.value, 78 );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( checkpoint_before_undo_states_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      account_balance_id_type modified;
+      account_balance_id_type created;
+      {
+         database db;
+         db.enable_checkpoints( 2 );
+         db.object_database::open( data_dir.path() );
+         modified = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 1; } )
+                      .get_id();
+         db.checkpoint();
+
+         // a reversible block
+         db._undo_db.enable();
+         {
+            auto session = db._undo_db.start_undo_session();
+            db.modify( modified(db), []( account_balance_object& obj ){ obj.balance = 5; } );
+            created = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 6; } )
+                        .get_id();
+            session.commit();
+         }
+         const auto values_before = db._undo_db.get_values_before( 1 );
+         db.checkpoint( &values_before );
+         BOOST_CHECK( fc::exists( data_dir.path() / "object_database" / "checkpoints" / "1" ) );
+      }
+      {
+         database db;
+         db.enable_checkpoints( 2 );
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( modified(db).balance.value, 1 );
+         BOOST_CHECK( db.find( created ) == nullptr );
+         BOOST_CHECK( db.get_index_type<account_balance_index>().get_next_id() == object_id_type( created ) );
+      }
+
+      // the objects saved with earlier values are saved again by the next checkpoint
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      {
+         database db;
+         db.enable_checkpoints( 3 );
+         db.object_database::open( data_dir2.path() );
+         modified = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 1; } )
+                      .get_id();
+         db.checkpoint();
+         db._undo_db.enable();
+         {
+            auto session = db._undo_db.start_undo_session();
+            db.modify( modified(db), []( account_balance_object& obj ){ obj.balance = 5; } );
+            created = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 6; } )
+                        .get_id();
+            session.commit();
+         }
+         const auto values_before = db._undo_db.get_values_before( 1 );
+         db.checkpoint( &values_before );
+         // the block has become irreversible
+         db.checkpoint();
+         BOOST_CHECK( fc::exists( data_dir2.path() / "object_database" / "checkpoints" / "2" ) );
+      }
+      {
+         database db;
+         db.object_database::open( data_dir2.path() );
+         BOOST_CHECK_EQUAL( modified(db).balance.value, 5 );
+         BOOST_CHECK_EQUAL( created(db).balance.value, 6 );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( damaged_checkpoint_segment_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const auto file = data_dir.path() / "object_database" / "checkpoints" / "0"
+                        / ( fc::to_string( account_balance_object::space_id ) + "."
+                            + fc::to_string( account_balance_object::type_id ) );
+      {
+         database db;
+         db.enable_checkpoints( 2 );
+         db.object_database::open( data_dir.path() );
+         db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 1; } );
+         db.flush();
+         db.create<account_balance_object>( []( account_balance_object& obj ){ obj.balance = 2; } );
+         db.checkpoint();
+         BOOST_REQUIRE( fc::exists( file ) );
+      }
+
+      // a damaged byte
+      {
+         std::fstream f( file.generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         f.seekg( -9, std::ios::end );
+         char c = 0;
+         f.read( &c, 1 );
+         c ^= 0x55;
+         f.seekp( -9, std::ios::end );
+         f.write( &c, 1 );
+      }
+      {
+         database db;
+         BOOST_CHECK_THROW( db.object_database::open( data_dir.path() ),
+                            graphene::db::corrupted_index_file_exception );
+         BOOST_CHECK( db.get_index_type<account_balance_index>().indices().empty() );
+      }
+
+      // a torn write
+      fc::resize_file( file, fc::file_size( file ) / 2 );
+      {
+         database db;
+         BOOST_CHECK_THROW( db.object_database::open( data_dir.path() ),
+                            graphene::db::corrupted_index_file_exception );
+      }
+      fc::resize_file( file, 0 );
+      {
+         database db;
+         BOOST_CHECK_THROW( db.object_database::open( data_dir.path() ),
+                            graphene::db::corrupted_index_file_exception );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( parallel_load_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const int64_t count = 150000; // above the threshold for loading with several threads
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         for( int64_t i = 0; i < count; ++i )
+            db.create<account_balance_object>( [i]( account_balance_object& obj ){
+               obj.owner = account_id_type( i );
+               obj.balance = i;
+            });
+         db.flush();
+      }
+      database db;
+      db.object_database::open( data_dir.path() );
+      const auto& bal_idx = db.get_index_type<account_balance_index>();
+      BOOST_CHECK_EQUAL( bal_idx.indices().size(), size_t(count) );
+      int64_t i = 0;
+      for( const account_balance_object& obj : bal_idx.indices() )
+      {
+         BOOST_CHECK_EQUAL( obj.id.instance(), uint64_t(i) );
+         BOOST_CHECK_EQUAL( obj.balance.value, i );
+         ++i;
+      }
+      BOOST_CHECK_EQUAL( i, count );
+      BOOST_CHECK( bal_idx.get_next_id() == object_id_type( account_balance_id_type( count ) ) );
+      // secondary indices are maintained as well
+      BOOST_CHECK( db.get_balance( account_id_type( 1234 ), asset_id_type() ).amount == 1234 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( index_file_verification_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const auto file = data_dir.path() / "object_database" / fc::to_string( account_balance_object::space_id )
+                                        / fc::to_string( account_balance_object::type_id );
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         // more than one block, so that some objects are loaded before the damaged block is reached
+         for( int64_t i = 0; i < 5000; ++i )
+            db.create<account_balance_object>( [i]( account_balance_object& obj ){ obj.balance = i; } );
+         db.flush();
+      }
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( db.get_index_type<account_balance_index>().indices().size(), 5000u );
+      }
+
+      // damage one byte in front of the checksum of the last block
+      {
+         std::fstream f( file.generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         f.seekg( -12, std::ios::end );
+         char c = 0;
+         f.read( &c, 1 );
+         c ^= 0x55;
+         f.seekp( -12, std::ios::end );
+         f.write( &c, 1 );
+      }
+      database db;
+      BOOST_CHECK_THROW( db.object_database::open( data_dir.path() ), graphene::db::corrupted_index_file_exception );
+      // what has been loaded is dropped again
+      BOOST_CHECK( db.get_index_type<account_balance_index>().indices().empty() );
+      BOOST_CHECK( db.get_index_type<account_balance_index>().get_next_id()
+                   == object_id_type( account_balance_id_type( 0 ) ) );
+      BOOST_CHECK( db.get_balance( account_id_type(), asset_id_type() ).amount == 0 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( merge_test )
 {
    try {
@@ -224,6 +632,62 @@ BOOST_AUTO_TEST_CASE( direct_index_test )
    // but the secondary has not updated its representation
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( expiration_wheel_test )
+{ try {
+   typedef graphene::db::expiration_wheel< withdraw_permission_object,
+         member< withdraw_permission_object, time_point_sec, &withdraw_permission_object::expiration >,
+         4 > small_wheel; // 16 seconds
+   graphene::db::primary_index< withdraw_permission_index > permits( db );
+   const auto& wheel = *permits.add_secondary_index< small_wheel >();
+
+   auto create = [&permits]( uint32_t expiration ) -> const withdraw_permission_object& {
+      return static_cast< const withdraw_permission_object& >( permits.create( [expiration]( object& o ) {
+         static_cast< withdraw_permission_object& >( o ).expiration = time_point_sec( expiration );
+      }));
+   };
+   auto next = [&wheel]( uint32_t deadline ) {
+      const withdraw_permission_object* result = wheel.next_expired( time_point_sec( deadline ) );
+      return result ? result->id : object_id_type();
+   };
+
+   const auto& p0 = create( 100 ); // beyond the wheel
+   const auto& p1 = create( 5 );
+   const auto& p2 = create( 5 );
+   const auto& p3 = create( 40 ); // beyond the wheel
+   const auto& p4 = create( 3 );
+   BOOST_CHECK_EQUAL( wheel.size(), 5u );
+
+   BOOST_CHECK( next( 2 ) == object_id_type() );
+   // same expiration is yielded by ID
+   BOOST_CHECK( next( 5 ) == p4.id );
+   permits.remove( p4 );
+   BOOST_CHECK( next( 5 ) == p1.id );
+   permits.remove( p1 );
+   BOOST_CHECK( next( 5 ) == p2.id );
+   permits.remove( p2 );
+   BOOST_CHECK( next( 5 ) == object_id_type() );
+
+   // a changed expiration moves the object
+   permits.modify( p0, []( object& o ) {
+      static_cast< withdraw_permission_object& >( o ).expiration = time_point_sec( 7 );
+   });
+   BOOST_CHECK( next( 6 ) == object_id_type() );
+   BOOST_CHECK( next( 10 ) == p0.id );
+   permits.remove( p0 );
+
+   // expirations in the past, e.g. of undone removals, are yielded first
+   const auto& p5 = create( 4 );
+   BOOST_CHECK( next( 3 ) == object_id_type() );
+   BOOST_CHECK( next( 50 ) == p5.id );
+   permits.remove( p5 );
+
+   BOOST_CHECK( next( 39 ) == object_id_type() );
+   BOOST_CHECK( next( 50 ) == p3.id );
+   permits.remove( p3 );
+   BOOST_CHECK_EQUAL( wheel.size(), 0u );
+   BOOST_CHECK( next( 1000 ) == object_id_type() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/bitshares/bitshares-core/issues/1719
 { try {
    ACTORS( (alice)(bob)(charlie)(agnetha)(benny)(carlos) );
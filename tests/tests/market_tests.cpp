@@ -2437,4 +2437,76 @@ BOOST_AUTO_TEST_CASE(mcfr_rounding_test_after2481)
 
 } FC_LOG_AND_RETHROW() }
 
+/// The price levels of limit_order_book_index follow the orders as they are created, filled, cancelled and undone
+BOOST_AUTO_TEST_CASE(limit_order_book_levels)
+{ try {
+   ACTORS((buyer)(seller));
+
+   const auto& usd = create_user_issued_asset( "BOOKUSD" );
+   const asset_id_type usd_id = usd.get_id();
+   const asset_id_type core_id;
+   issue_uia( seller, usd.amount( 1000 ) );
+   transfer( committee_account, buyer_id, asset( 10000 ) );
+
+   const auto& book = db.get_index_type< primary_index< limit_order_index > >()
+                         .get_secondary_index< limit_order_book_index >();
+   BOOST_CHECK( book.find_side( core_id, usd_id ) == nullptr );
+
+   const limit_order_id_type b1 = create_sell_order( buyer, asset( 100 ), usd.amount( 10 ) )->get_id();
+   const limit_order_id_type b2 = create_sell_order( buyer, asset( 200 ), usd.amount( 20 ) )->get_id();
+   const limit_order_id_type b3 = create_sell_order( buyer, asset( 100 ), usd.amount( 20 ) )->get_id();
+
+   auto check_side = [&]( const vector< std::pair< share_type, vector<limit_order_id_type> > >& expected ) {
+      const auto* side = book.find_side( core_id, usd_id );
+      BOOST_REQUIRE( side != nullptr );
+      BOOST_REQUIRE_EQUAL( side->size(), expected.size() );
+      auto level_itr = side->begin();
+      for( const auto& level : expected )
+      {
+         BOOST_CHECK_EQUAL( level_itr->second.total_for_sale.value, level.first.value );
+         BOOST_REQUIRE_EQUAL( level_itr->second.orders.size(), level.second.size() );
+         auto order_itr = level_itr->second.orders.begin();
+         for( const auto& id : level.second )
+         {
+            BOOST_CHECK( order_itr->first == id );
+            BOOST_CHECK( order_itr->second == &id(db) );
+            ++order_itr;
+         }
+         ++level_itr;
+      }
+      BOOST_CHECK( book.best_order( core_id, usd_id ) == &expected.front().second.front()(db) );
+   };
+
+   // b1 and b2 have the same price and share the best level
+   check_side( { { 300, { b1, b2 } }, { 100, { b3 } } } );
+
+   // a partial fill only changes the amount of the level
+   BOOST_CHECK( create_sell_order( seller, usd.amount( 5 ), asset( 50 ) ) == nullptr );
+   BOOST_CHECK_EQUAL( b1(db).for_sale.value, 50 );
+   BOOST_CHECK( book.find_side( usd_id, core_id ) == nullptr );
+   check_side( { { 250, { b1, b2 } }, { 100, { b3 } } } );
+
+   {
+      auto session = db._undo_db.start_undo_session();
+      db.cancel_limit_order( b1(db) );
+      check_side( { { 200, { b2 } }, { 100, { b3 } } } );
+      db.cancel_limit_order( b3(db) );
+      check_side( { { 200, { b2 } } } );
+   }
+   check_side( { { 250, { b1, b2 } }, { 100, { b3 } } } );
+
+   // the book yields the orders in the order of the by_price index
+   const auto& by_price_idx = db.get_index_type< limit_order_index >().indices().get< by_price >();
+   auto itr = by_price_idx.lower_bound( price::max( core_id, usd_id ) );
+   for( const auto& level : *book.find_side( core_id, usd_id ) )
+      for( const auto& order : level.second.orders )
+      {
+         BOOST_REQUIRE( itr != by_price_idx.end() );
+         BOOST_CHECK( itr->id == order.first );
+         ++itr;
+      }
+   BOOST_CHECK( itr == by_price_idx.upper_bound( price::min( core_id, usd_id ) ) );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
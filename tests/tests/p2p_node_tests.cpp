@@ -12,6 +12,7 @@
 
 #include <graphene/net/node.hpp>
 #include <graphene/net/peer_connection.hpp>
+#include <graphene/net/rolling_bloom_filter.hpp>
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/io/raw.hpp>
@@ -50,9 +51,9 @@ public:
       }
    }
    void on_connection_closed( graphene::net::peer_connection* originating_peer ) override {}
-   graphene::net::message get_message_for_item( const graphene::net::item_id& item ) override
+   std::shared_ptr<const graphene::net::message> get_message_for_item( const graphene::net::item_id& item ) override
    {
-      return graphene::net::message();
+      return std::make_shared<const graphene::net::message>();
    }
    std::shared_ptr< graphene::net::message > last_message = nullptr;
 };
@@ -75,6 +76,12 @@ public:
       messages_received.push_back( message_to_send );
    }
 
+   void send_message( std::shared_ptr<const graphene::net::message> message_to_send,
+         size_t message_send_time_field_offset = (size_t)-1 ) override
+   {
+      messages_received.push_back( *message_to_send );
+   }
+
    graphene::net::node_id_t get_public_key() const
    {
       return generated_private_key.get_public_key();
@@ -980,4 +987,103 @@ BOOST_AUTO_TEST_CASE( advertising_all_test )
    test_closing_connection_message( msg2 );
 }
 
+/****
+ * A compact block is completed with the transactions in the message cache and the ones fetched from the peer
+ */
+BOOST_AUTO_TEST_CASE( compact_block_test )
+{ try {
+   // create a node (node1)
+   int node1_port = fc::network::get_available_port();
+   fc::temp_directory node1_dir( graphene::utilities::temp_directory_path() );
+   test_node node1( "Node1", node1_dir.path(), node1_port );
+   // simulate that node1 started to connect to the network and accepting connections
+   fake_network_connect_guard guard( node1 );
+
+   // a new peer (peer3)
+   std::pair<std::shared_ptr<test_delegate>, std::shared_ptr<test_peer>> peer3
+         = node1.create_test_peer( "1.2.3.4:5678" );
+   std::shared_ptr<test_peer> peer3_ptr = peer3.second;
+   // simulate that node1 got its hello request and accepted the connection
+   peer3_ptr->their_state = test_peer::their_connection_state::connection_accepted;
+
+   // a block with two transactions, node1 has received the first one already
+   graphene::protocol::signed_transaction trx1;
+   trx1.expiration = fc::time_point_sec( 1000 );
+   graphene::protocol::signed_transaction trx2;
+   trx2.expiration = fc::time_point_sec( 2000 );
+   node1.broadcast( graphene::net::trx_message( trx1 ) );
+
+   graphene::protocol::signed_block block;
+   block.timestamp = fc::time_point_sec( 3000 );
+   block.transactions.emplace_back( trx1 );
+   block.transactions.emplace_back( trx2 );
+   block.transactions.back().operation_results.emplace_back( graphene::protocol::void_result() );
+   block.transaction_merkle_root = block.calculate_merkle_root();
+   graphene::net::block_message block_msg( block );
+
+   // node1 asked peer3 for the block
+   graphene::net::item_id requested_item( graphene::net::block_message_type,
+                                          graphene::net::message( block_msg ).id() );
+   peer3_ptr->items_requested_from_peer[requested_item] = fc::time_point::now();
+
+   // peer3 sends the block without the transactions
+   node1.on_message( peer3_ptr, graphene::net::compact_block_message( block_msg ) );
+
+   // node1 asks for the second transaction only
+   BOOST_REQUIRE_EQUAL( peer3_ptr->messages_received.size(), 1U );
+   const auto& msg = peer3_ptr->messages_received.front();
+   BOOST_REQUIRE( msg.msg_type.value() == graphene::net::fetch_block_transactions_message::type );
+   const auto request = msg.as<graphene::net::fetch_block_transactions_message>();
+   BOOST_CHECK( request.block_id == block_msg.block_id );
+   BOOST_REQUIRE_EQUAL( request.transaction_indexes.size(), 1U );
+   BOOST_CHECK_EQUAL( request.transaction_indexes.front(), 1U );
+
+   // peer3 sends it
+   graphene::net::block_transactions_message reply( request.block_id, request.transaction_indexes );
+   reply.transactions.emplace_back( trx2 );
+   peer3_ptr->messages_received.clear();
+   node1.on_message( peer3_ptr, reply );
+
+   // node1 got the block it asked for and processed it without complaining
+   BOOST_CHECK_EQUAL( peer3_ptr->messages_received.size(), 0U );
+   BOOST_CHECK( peer3_ptr->compact_blocks_being_completed.empty() );
+   BOOST_CHECK( peer3_ptr->items_requested_from_peer.empty() );
+} FC_CAPTURE_LOG_AND_RETHROW( (0) ) }
+
+BOOST_AUTO_TEST_CASE( rolling_bloom_filter_test )
+{ try {
+   const uint32_t items_per_generation = 1000;
+   graphene::net::rolling_bloom_filter filter( items_per_generation, 0.001, fc::minutes(2) );
+   auto make_item = []( uint32_t i ) {
+      return graphene::net::item_id( graphene::net::trx_message_type, fc::ripemd160::hash( fc::to_string( i ) ) );
+   };
+
+   // a full generation is remembered
+   for( uint32_t i = 0; i < items_per_generation; ++i )
+      filter.insert( make_item( i ) );
+   for( uint32_t i = 0; i < items_per_generation; ++i )
+      BOOST_CHECK( filter.contains( make_item( i ) ) );
+
+   // and so is the one before the current
+   for( uint32_t i = items_per_generation; i < 2 * items_per_generation; ++i )
+      filter.insert( make_item( i ) );
+   for( uint32_t i = 0; i < 2 * items_per_generation; ++i )
+      BOOST_CHECK( filter.contains( make_item( i ) ) );
+
+   // items never inserted are rarely reported
+   uint32_t false_positives = 0;
+   for( uint32_t i = 2 * items_per_generation; i < 12 * items_per_generation; ++i )
+      false_positives += filter.contains( make_item( i ) );
+   BOOST_CHECK_LT( false_positives, 50U );
+
+   // the oldest generation is forgotten once a third one starts
+   for( uint32_t i = 2 * items_per_generation; i < 3 * items_per_generation; ++i )
+      filter.insert( make_item( i ) );
+   filter.insert( make_item( 3 * items_per_generation ) );
+   uint32_t remembered = 0;
+   for( uint32_t i = 0; i < items_per_generation; ++i )
+      remembered += filter.contains( make_item( i ) );
+   BOOST_CHECK_LT( remembered, 10U );
+} FC_CAPTURE_LOG_AND_RETHROW( (0) ) }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -959,4 +959,76 @@ BOOST_AUTO_TEST_CASE( committee_votes_calculation )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( cached_vote_tally )
+{ try {
+   generate_blocks( HARDFORK_CORE_2262_TIME );
+   generate_block();
+   set_expiration( db, trx );
+
+   ACTORS( (alice)(bob)(carol) );
+   db.set_vote_tally_recount_interval( 100 );
+
+   const witness_id_type witness1_id( 1 );
+   const witness_id_type witness2_id( 2 );
+   const vote_id_type witness1_vote = witness1_id(db).vote_id;
+   const vote_id_type witness2_vote = witness2_id(db).vote_id;
+
+   auto vote = [this]( const account_id_type& account, const private_key_type& key,
+                       const account_id_type& voting_account, const flat_set<vote_id_type>& votes ) {
+      account_update_operation op;
+      op.account = account;
+      op.new_options = account(db).options;
+      op.new_options->voting_account = voting_account;
+      op.new_options->votes = votes;
+      op.new_options->num_witness = static_cast<uint16_t>( votes.size() );
+      trx.operations.push_back( op );
+      sign( trx, key );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   };
+   auto maintenance = [this]() {
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      generate_block();
+      set_expiration( db, trx );
+   };
+
+   transfer( committee_account, alice_id, asset(1000) );
+   transfer( committee_account, bob_id, asset(200) );
+   transfer( committee_account, carol_id, asset(30) );
+   vote( alice_id, alice_private_key, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { witness1_vote } );
+   vote( bob_id, bob_private_key, alice_id, {} );
+   vote( carol_id, carol_private_key, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { witness2_vote } );
+
+   maintenance();
+   const uint64_t witness1_votes = witness1_id(db).total_votes;
+   const uint64_t witness2_votes = witness2_id(db).total_votes;
+   BOOST_CHECK_EQUAL( db.get_account_stats_by_owner( alice_id ).vp_all, 1200u );
+
+   // nothing changed, the cached votes are tallied again
+   maintenance();
+   BOOST_CHECK_EQUAL( witness1_id(db).total_votes, witness1_votes );
+   BOOST_CHECK_EQUAL( witness2_id(db).total_votes, witness2_votes );
+   BOOST_CHECK_EQUAL( db.get_account_stats_by_owner( alice_id ).vp_all, 1200u );
+
+   // a balance change of an account voting by proxy
+   transfer( committee_account, bob_id, asset(5) );
+   maintenance();
+   BOOST_CHECK_EQUAL( witness1_id(db).total_votes, witness1_votes + 5 );
+   BOOST_CHECK_EQUAL( witness2_id(db).total_votes, witness2_votes );
+   BOOST_CHECK_EQUAL( db.get_account_stats_by_owner( alice_id ).vp_all, 1205u );
+
+   // the proxy changes its votes, bob's votes follow without bob changing
+   vote( alice_id, alice_private_key, GRAPHENE_PROXY_TO_SELF_ACCOUNT, { witness2_vote } );
+   maintenance();
+   BOOST_CHECK_EQUAL( witness1_id(db).total_votes, witness1_votes - 1200 );
+   BOOST_CHECK_EQUAL( witness2_id(db).total_votes, witness2_votes + 1205 );
+
+   // recounting every time gives the same result
+   db.set_vote_tally_recount_interval( 0 );
+   maintenance();
+   BOOST_CHECK_EQUAL( witness1_id(db).total_votes, witness1_votes - 1200 );
+   BOOST_CHECK_EQUAL( witness2_id(db).total_votes, witness2_votes + 1205 );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
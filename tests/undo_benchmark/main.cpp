@@ -0,0 +1,84 @@
+/*
+ * Acloudbank
+ */
+#include "../common/init_unit_test_suite.hpp"
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/time.hpp>
+
+#include "../common/database_fixture.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Count heap allocations to measure the allocator pressure of the undo database. The replaced operators apply to
+// the whole binary, which is why this benchmark lives in its own executable instead of performance_test.
+namespace {
+   std::atomic<uint64_t> heap_allocations( 0 );
+}
+
+void* operator new( std::size_t size )
+{
+   heap_allocations.fetch_add( 1, std::memory_order_relaxed );
+   void* p = std::malloc( size == 0 ? 1 : size );
+   if( p == nullptr )
+      throw std::bad_alloc();
+   return p;
+}
+
+void operator delete( void* p ) noexcept
+{
+   std::free( p );
+}
+
+void operator delete( void* p, std::size_t ) noexcept
+{
+   std::free( p );
+}
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_CASE( pending_transfers_benchmark, database_fixture )
+{ try {
+   ACTORS( (alice)(bob) );
+
+   const uint64_t cycles = 100000;
+
+   transfer_operation op;
+   op.from = alice_id;
+   op.to = bob_id;
+   op.amount = asset( 1 );
+   op.fee = db.current_fee_schedule().calculate_fee( op );
+   fund( alice, asset( ( op.fee.amount.value + int64_t(cycles) ) * int64_t(cycles) ) );
+
+   std::vector<signed_transaction> transactions;
+   transactions.reserve( cycles );
+   trx.clear();
+   test::set_expiration( db, trx );
+   for( uint32_t i = 0; i < cycles; ++i )
+   {
+      // the amounts differ to give the transactions different IDs, the pool holds each ID once
+      op.amount = asset( i + 1 );
+      trx.operations.push_back( op );
+      transactions.push_back( trx );
+      trx.operations.clear();
+   }
+
+   // Every transfer runs in its own undo session which is merged into the pending session
+   const uint64_t allocations_before = heap_allocations.load();
+   auto start = fc::time_point::now();
+   for( uint32_t i = 0; i < cycles; ++i )
+      db.push_transaction( transactions[i], ~0 );
+   auto end = fc::time_point::now();
+   const uint64_t allocations = heap_allocations.load() - allocations_before;
+   auto elapsed = end - start;
+
+   wlog( "Pushed ${n} transfers in ${total}ms, ${tps} trx/s, ${apt} heap allocations per trx",
+         ("n",cycles)("total",elapsed.count()/1000)("tps",(cycles*1000000)/elapsed.count())
+         ("apt",double(allocations)/cycles) );
+
+   db.clear_pending();
+} FC_LOG_AND_RETHROW() }